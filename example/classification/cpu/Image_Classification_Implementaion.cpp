@@ -10,6 +10,11 @@
 #include <onnxruntime_cxx_api.h>
 #include <opencv2/opencv.hpp>
 #include <filesystem>
+#include "utils/image_decoder.hpp"
+#include "utils/image_preprocess.hpp"
+#include "utils/ort_execution_provider.hpp"
+#include "utils/ort_model_cache.hpp"
+#include "utils/ort_session_pool.hpp"
 
 using namespace std;
 using namespace cv;
@@ -24,35 +29,56 @@ using namespace Ort;
 // If you use unmanaged data types such as dynamic arrays (e.g., int* data = new int[...]), you must ensure that they are properly deleted at the end of runInference() definition.
 using BMTDataType = vector<float>;
 
+// Queries per session->Run. 0: picked in Initialize by timing batches up to ORT_MAX_BATCH.
+constexpr size_t ORT_BATCH_SIZE = 0;
+constexpr size_t ORT_MAX_BATCH = 16;
+
+// ORT sessions as "threads@cpus;..." (see parse_session_topology), e.g. "4@4-7;4@0-3" for one
+// pinned session per RK3588 cluster. Empty: one session with ORT's default thread count.
+constexpr const char *ORT_SESSION_TOPOLOGY = "";
+
+// Execution providers in order of preference (see parse_provider_list). Providers not built into
+// the ORT library are skipped, one that fails to build the session falls back to the next, and
+// the CPU provider is always last. The chosen one and ORT's node placement are printed at startup.
+constexpr const char *ORT_EXECUTION_PROVIDERS = "xnnpack,acl,armnn,cpu";
+
+// Save the optimized graph next to the model (<model>.<key>.ort, see OrtModelCache) and load it on
+// later launches instead of optimizing the model again.
+constexpr bool ORT_MODEL_CACHE = true;
+
 // To view detailed information on what and how to implement for "AI_BMT_Interface," navigate to its definition (e.g., in Visual Studio/VSCode: Press F12).
 class ImageClassification_Interface_Implementation : public AI_BMT_Interface
 {
 private:
-    Env env;
-    RunOptions runOptions;
-    shared_ptr<Session> session;
-    array<const char *, 1> inputNames;
-    array<const char *, 1> outputNames;
-    MemoryInfo memory_info = Ort::MemoryInfo::CreateCpu(OrtDeviceAllocator, OrtMemTypeCPU);
+    OrtPlacementLog placement_log; // before env, which logs into it
+    Env env{ORT_LOGGING_LEVEL_WARNING, "AI_BMT", OrtPlacementLog::log, &placement_log};
+    unique_ptr<OrtSessionPool> sessions;
 
 public:
+    ~ImageClassification_Interface_Implementation()
+    {
+        if (sessions)
+            sessions->report(cout);
+    }
+
     virtual void Initialize(string modelPath) override
     {
         // session initializer
         SessionOptions sessionOptions;
         sessionOptions.SetExecutionMode(ExecutionMode::ORT_SEQUENTIAL);
-        sessionOptions.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_EXTENDED);
-        wstring modelPathwstr(modelPath.begin(), modelPath.end());
-        session = make_shared<Session>(env, modelPathwstr.c_str(), sessionOptions);
-
-        // Get input and output names
-        AllocatorWithDefaultOptions allocator;
-        AllocatedStringPtr inputName = session->GetInputNameAllocated(0, allocator);
-        AllocatedStringPtr outputName = session->GetOutputNameAllocated(0, allocator);
-        inputNames = {inputName.get()};
-        outputNames = {outputName.get()};
-        inputName.release();
-        outputName.release();
+        // ORT_ENABLE_EXTENDED is applied by the cache, which skips it for an already optimized model.
+        OrtModelCache modelCache(env, modelPath, GraphOptimizationLevel::ORT_ENABLE_EXTENDED, ORT_MODEL_CACHE);
+        sessions = make_unique<OrtSessionPool>(parse_session_topology(ORT_SESSION_TOPOLOGY), sessionOptions,
+                                               provider_session_factory(parse_provider_list(ORT_EXECUTION_PROVIDERS),
+                                                                        [&modelCache](const SessionOptions &options, OrtProvider provider)
+                                                                        { return modelCache.create(options, provider_name(provider)); },
+                                                                        &placement_log));
+
+        // Batches need a dynamic batch dimension ({-1, 3, 224, 224}); a fixed one runs with batch 1.
+        if (ORT_BATCH_SIZE > 0)
+            sessions->set_batch_size(ORT_BATCH_SIZE);
+        else
+            sessions->tune(ORT_MAX_BATCH);
     }
 
     virtual Optional_Data getOptionalData() override
@@ -73,74 +99,21 @@ public:
 
     virtual VariantType convertToPreprocessedDataForInference(const string &imagePath) override
     {
-        Mat image = imread(imagePath);
-        if (image.empty())
-        {
-            throw runtime_error("Failed to load image: " + imagePath);
-        }
-
-        // convert BGR to RGB before reshaping
-        cvtColor(image, image, cv::COLOR_BGR2RGB);
-
-        // reshape (3D -> 1D)
-        image = image.reshape(1, 1);
-
-        // uint_8, [0, 255] -> float, [0 and 1] => Normalize number to between 0 and 1, Convert to vector<float> from cv::Mat.
-        vector<float> vec;
-        image.convertTo(vec, CV_32FC1, 1. / 255);
-
-        // Mean and Std deviation values
-        const vector<float> means = {0.485, 0.456, 0.406};
-        const vector<float> stds = {0.229, 0.224, 0.225};
-
-        // Transpose (Height, Width, Channel)(224,224,3) to (Chanel, Height, Width)(3,224,224)
-        BMTDataType output;
-        for (size_t ch = 0; ch < 3; ++ch)
-        {
-            for (size_t i = ch; i < vec.size(); i += 3)
-            {
-                float normalized = (vec[i] - means[ch]) / stds[ch];
-                output.emplace_back(normalized);
-            }
-        }
+        // Throws if the image can't be read.
+        Mat image = decode_image(imagePath, 224, 224);
+
+        // BGR -> RGB, [0, 255] -> [0, 1], ImageNet mean/std and HWC -> CHW in one pass into the final buffer.
+        BMTDataType output(3 * static_cast<size_t>(image.rows) * image.cols);
+        bgr_to_chw(image.data, image.cols, image.rows, image.step, ChannelNormalization::imagenet(), output.data());
         return output;
     }
 
     virtual vector<BMTResult> runInference(const vector<VariantType> &data) override
     {
-        const int querySize = data.size();
-        vector<BMTResult> results;
-
-        // onnx option setting
-        const array<int64_t, 4> inputShape = {1, 3, 224, 224};
-        const array<int64_t, 2> outputShape = {1, 1000};
-
-        for (int i = 0; i < querySize; ++i)
-        {
-            // Prepare input/output tensors
-            BMTDataType imageVec;
-            try
-            {
-                imageVec = get<BMTDataType>(data[i]);
-            }
-            catch (const std::bad_variant_access &e)
-            {
-                cerr << "Error: bad_variant_access at index " << i << ". Reason: " << e.what() << endl;
-                continue;
-            }
-            vector<float> outputData(1000);
-            auto inputTensor = Ort::Value::CreateTensor<float>(memory_info, imageVec.data(), imageVec.size(), inputShape.data(), inputShape.size());
-            auto outputTensor = Ort::Value::CreateTensor<float>(memory_info, outputData.data(), outputData.size(), outputShape.data(), outputShape.size());
-
-            // Run inference
-            session->Run(runOptions, inputNames.data(), &inputTensor, 1, outputNames.data(), &outputTensor, 1);
-
-            // Update results
-            BMTResult result;
-            result.classProbabilities = outputData;
-            results.push_back(result);
-        }
-
+        // {N, 3, 224, 224} per Run, {N, 1000} scattered back to the queries.
+        vector<BMTResult> results(data.size());
+        sessions->run(data, [&results](size_t i, const float *output, size_t count)
+                    { results[i].classProbabilities.assign(output, output + count); });
         return results;
     }
 };
@@ -3,13 +3,15 @@
 #include <filesystem>
 #include <opencv2/opencv.hpp>
 #include "dxrt/dxrt_api.h"
+#include "utils/image_decoder.hpp"
+#include "utils/tensor_packer.hpp"
 using namespace std;
 using namespace cv;
 class Classification_Implementation_SingleCore : public AI_BMT_Interface
 {
     shared_ptr<dxrt::InferenceEngine> ie;
-    int align_factor;
-    int input_w = 224, input_h = 224, input_c = 3;
+    int input_w = 224, input_h = 224;
+    TensorPackLayout input_layout = TensorPackLayout::dxnn(input_w, input_h);
 
 public:
     virtual Optional_Data getOptionalData() override
@@ -26,21 +28,14 @@ public:
     {
         cout << "Initialze() is called" << endl;
         ie = make_shared<dxrt::InferenceEngine>(modelPath);
-        align_factor = ((int)(input_w * input_c)) & (-64);
-        align_factor = (input_w * input_c) - align_factor;
     }
 
     virtual VariantType convertToPreprocessedDataForInference(const string &imagePath) override
     {
         cv::Mat input;
-        input = cv::imread(imagePath, cv::IMREAD_COLOR);
-        cv::cvtColor(input, input, cv::COLOR_BGR2RGB);
-        vector<uint8_t> inputBuf(input_h * (input_w * input_c + align_factor));
-        for (int y = 0; y < input_h; y++)
-        {
-            memcpy(&inputBuf[y * (input_w * input_c + align_factor)], &input.data[y * input_w * input_c], input_w * input_c);
-        }
-        return inputBuf;
+        decode_image(imagePath, input_w, input_h, input);
+        // RGB swap and 64-byte row padding in one pass, straight into the buffer the device reads.
+        return pack_tensor(input, input_layout);
     }
 
     virtual vector<BMTResult> runInference(const vector<VariantType> &data) override
@@ -15,6 +15,10 @@
 #include <mutex>
 #include <future>
 #include "utils/async_inference.hpp"
+#include "utils/async_pipeline.hpp"
+#include "utils/hailo_backend.hpp"
+#include "utils/image_decoder.hpp"
+#include "utils/multi_device_backend.hpp"
 #include "utils/utils.hpp"
 using namespace hailort;
 using namespace std;
@@ -27,7 +31,7 @@ constexpr int HEIGHT = 224;
 
 using BMTDataType = vector<float>;
 /////////// Constants ///////////
-constexpr size_t MAX_QUEUE_SIZE = 9960;
+constexpr size_t NUM_CLASSES = 1000;
 /////////////////////////////////
 
 int argmax(const std::vector<float> &vec)
@@ -35,65 +39,18 @@ int argmax(const std::vector<float> &vec)
     return static_cast<int>(std::distance(vec.begin(), std::max_element(vec.begin(), vec.end())));
 }
 
-hailo_status run_preprocess(std::shared_ptr<BoundedTSQueue<PreprocessedFrameItem>> preprocessed_queue, const vector<VariantType> &data, size_t start, size_t end)
+// Copying 1000 floats is cheap enough to run on the HailoRT completion thread,
+// so the pipeline is created without decode threads.
+void decode_scores(const InferenceCompletion &completion, BMTResult &result)
 {
-    for (int i = start; i < end; i++)
-    {
-        vector<uint8_t> inputBuf = get<vector<uint8_t>>(data[i]);
-        auto preprocessed_frame_item = create_preprocessed_frame_item(inputBuf, WIDTH, HEIGHT, i);
-        preprocessed_queue->push(preprocessed_frame_item);
-    }
-    preprocessed_queue->stop();
-    return HAILO_SUCCESS;
-}
-
-hailo_status run_inference_async(std::shared_ptr<BoundedTSQueue<PreprocessedFrameItem>> preprocessed_queue, shared_ptr<AsyncModelInfer> model)
-{
-    while (true)
-    {
-        PreprocessedFrameItem item;
-        if (!preprocessed_queue->pop(item))
-            break;
-        
-        model->infer(std::make_shared<vector<uint8_t>>(item.resized_for_infer), item.frame_idx);
-    }
-
-    return HAILO_SUCCESS;
-}
-
-hailo_status run_post_process(std::shared_ptr<BoundedTSQueue<InferenceOutputItem>> results_queue, vector<BMTResult> &batchResult, size_t bs)
-{
-
-    size_t i = 0;
-    while (true)
-    {
-        InferenceOutputItem output_item;
-        if (!results_queue->pop(output_item))
-            break;
-
-        auto frame_idx = output_item.frame_idx;
-        // std::cout<<output_item.frame_idx<<std::endl;
-        size_t num_elements = 1000;
-        std::vector<float> float_data(num_elements);
-        std::memcpy(float_data.data(), output_item.output_data_and_infos[0].first, float_data.size() * sizeof(float));
-        BMTResult result;
-
-        result.classProbabilities = float_data;
-        batchResult[frame_idx] = result;
-        i++;
-        if (i == bs)
-            results_queue->stop();
-    }
-
-    return HAILO_SUCCESS;
+    const float *scores = reinterpret_cast<const float *>(completion.outputs[0].data);
+    result.classProbabilities.assign(scores, scores + NUM_CLASSES);
 }
 
 class Virtual_Submitter_Implementation : public AI_BMT_Interface
 {
     // string modelPath;
-    std::shared_ptr<BoundedTSQueue<PreprocessedFrameItem>> preprocessed_queue;
-    std::shared_ptr<BoundedTSQueue<InferenceOutputItem>> results_queue;
-    shared_ptr<AsyncModelInfer> model;
+    unique_ptr<AsyncPipeline> pipeline;
 
 public:
     Virtual_Submitter_Implementation()
@@ -119,21 +76,14 @@ public:
 
    virtual void Initialize(string modelPath) override
     {
-        model = make_shared<AsyncModelInfer>();
-        model->crt();
-        model->PathAndResult(modelPath);
-        preprocessed_queue = std::make_shared<BoundedTSQueue<PreprocessedFrameItem>>(MAX_QUEUE_SIZE);
-        results_queue = std::make_shared<BoundedTSQueue<InferenceOutputItem>>(MAX_QUEUE_SIZE);
-        model->configure(results_queue);
+        // Every Hailo device on the host gets its own backend; frames are spread across them.
+        pipeline = make_unique<AsyncPipeline>(combine_backends(create_hailo_backends(modelPath)));
     }
 
     virtual VariantType convertToPreprocessedDataForInference(const string &imagePath) override
     {
-        cv::Mat img = cv::imread(imagePath, cv::IMREAD_COLOR);
-        if (img.empty())
-        {
-            throw std::runtime_error("Image not found or invalid.");
-        }
+        // Scaled JPEG decode straight to the network size; throws if the image can't be read.
+        cv::Mat img = decode_image(imagePath, WIDTH, HEIGHT);
 
         cv::cvtColor(img, img, cv::COLOR_BGR2RGB);
         vector<uint8_t> inputBuf(HEIGHT * WIDTH * 3);
@@ -144,38 +94,18 @@ public:
 
     virtual vector<BMTResult> runInference(const vector<VariantType> &data) override
     {
-        size_t frame_count = data.size();
-        vector<BMTResult> batchResult(frame_count);
-        for (size_t i = 0; i < frame_count; i += MAX_QUEUE_SIZE)
+        vector<BMTResult> batchResult;
+        PipelineStats stats = pipeline->run(data, batchResult, decode_scores);
+        if (stats.failed_frames > 0)
         {
-            size_t currentBatchSize = min(MAX_QUEUE_SIZE, frame_count - i);
-            size_t start = i;
-            size_t end = i + currentBatchSize;
-            auto preprocess_thread = std::async(run_preprocess,
-                                                preprocessed_queue,
-                                                std::ref(data),
-                                                start,
-                                                end);
-            auto inference_thread = std::async(run_inference_async,
-                                               preprocessed_queue,
-                                               model);
-            auto output_parser_thread = std::async(run_post_process,
-                                                   results_queue,
-                                                   std::ref(batchResult),
-                                                   currentBatchSize);
-            hailo_status status = wait_and_check_threads(
-                preprocess_thread, "Preprocess",
-                inference_thread, "Inference",
-                output_parser_thread, "Postprocess ");
-
-            if (status != HAILO_SUCCESS)
+            // Keep going: a frame the device failed on scores as a miss instead of aborting the run.
+            cerr << "-W- " << stats.failed_frames << " of " << stats.frames << " frames failed" << endl;
+            for (auto &result : batchResult)
             {
-                throw std::runtime_error("Inference failed");
+                if (result.classProbabilities.empty())
+                    result.classProbabilities.assign(NUM_CLASSES, 0.0f);
             }
         }
-        preprocessed_queue->reset();
-        results_queue->reset();
-        model->clear();
         return batchResult;
     }
 };
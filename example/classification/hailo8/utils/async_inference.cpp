@@ -1,6 +1,10 @@
 #include "async_inference.hpp"
 #include "utils.hpp"
 
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
 #if defined(__unix__)
 #include <sys/mman.h>
 #endif
@@ -46,8 +50,6 @@ AsyncModelInfer::AsyncModelInfer(const std::string &hef_path,
     for (auto& output : outputs) {
         output.set_format_type(HAILO_FORMAT_TYPE_FLOAT32);
     }
-    this->input_buffer_guards.reserve(this->infer_model->inputs().size());
-    this->output_buffer_guards.reserve(this->infer_model->outputs().size());
 
     for (auto& output_vstream_info : this->infer_model->hef().get_output_vstream_infos().release()) {
         std::string name(output_vstream_info.name);
@@ -65,7 +67,29 @@ void AsyncModelInfer::crt(){
     this->vdevice = std::move(vdevice_exp.value()); 
 
 }
-void AsyncModelInfer::PathAndResult(const std::string &hef_path)
+void AsyncModelInfer::crt(const std::string &device_id){
+    hailo_vdevice_params_t params;
+    hailo_init_vdevice_params(&params);
+    hailo_device_id_t id = {};
+    std::strncpy(id.id, device_id.c_str(), sizeof(id.id) - 1);
+    params.device_ids = &id;
+    params.device_count = 1;
+    auto vdevice_exp = hailort::VDevice::create(params);
+    if (!vdevice_exp) {
+        std::cerr << "Failed to create VDevice on " << device_id << ", status = " << vdevice_exp.status() << std::endl;
+        throw std::runtime_error("Failed to create VDevice");
+    }
+    this->vdevice = std::move(vdevice_exp.value());
+}
+std::vector<std::string> AsyncModelInfer::scan_device_ids(){
+    auto device_ids_exp = hailort::Device::scan();
+    if (!device_ids_exp) {
+        std::cerr << "Failed to scan devices, status = " << device_ids_exp.status() << std::endl;
+        return {};
+    }
+    return device_ids_exp.release();
+}
+void AsyncModelInfer::PathAndResult(const std::string &hef_path, hailo_format_type_t output_format)
 {
     
     auto infer_model_exp = this->vdevice->create_infer_model(hef_path);
@@ -76,13 +100,12 @@ void AsyncModelInfer::PathAndResult(const std::string &hef_path)
     
 
     this->infer_model = infer_model_exp.release();
-    auto outputs = this->infer_model->outputs();
-    for (auto& output : outputs) {
-        output.set_format_type(HAILO_FORMAT_TYPE_FLOAT32);
+    if (HAILO_FORMAT_TYPE_AUTO != output_format) {
+        auto outputs = this->infer_model->outputs();
+        for (auto& output : outputs) {
+            output.set_format_type(output_format);
+        }
     }
-    infer_model->set_batch_size(32);
-    this->input_buffer_guards.reserve(this->infer_model->inputs().size());
-    this->output_buffer_guards.reserve(this->infer_model->outputs().size());
 
     for (auto& output_vstream_info : this->infer_model->hef().get_output_vstream_infos().release()) {
         std::string name(output_vstream_info.name);
@@ -103,92 +126,319 @@ const std::shared_ptr<hailort::InferModel> AsyncModelInfer::get_infer_model(){
     return this->infer_model;
 }
 
-void AsyncModelInfer::configure(std::shared_ptr<BoundedTSQueue<InferenceOutputItem>> output_data_queue) { 
+void BindingSetPool::add(BindingSet binding_set)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_sets.push_back(std::move(binding_set));
+    m_free.push_back(m_sets.size() - 1);
+}
+
+std::shared_ptr<BindingSet> BindingSetPool::acquire()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cond_free.wait(lock, [this] { return !m_free.empty(); });
+    size_t index = m_free.back();
+    m_free.pop_back();
+
+    auto self = shared_from_this();
+    return std::shared_ptr<BindingSet>(&m_sets[index], [self, index](BindingSet *) { self->release(index); });
+}
+
+void BindingSetPool::release(size_t index)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_sets[index].input_guard.reset();
+        m_free.push_back(index);
+    }
+    m_cond_free.notify_all();
+}
+
+size_t BindingSetPool::size()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_sets.size();
+}
 
-    this->configured_infer_model = this->infer_model->configure().expect("Failed to create configured infer model");
-    this->bindings = configured_infer_model.create_bindings().expect("Failed to create infer bindings");
+size_t BindingSetPool::in_flight()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_sets.size() - m_free.size();
+}
+
+void BindingSetPool::wait_all_released()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cond_free.wait(lock, [this] { return m_free.size() == m_sets.size(); });
+}
+
+void AsyncModelInfer::configure(std::shared_ptr<BoundedTSQueue<InferenceOutputItem>> output_data_queue,
+                                size_t binding_set_count,
+                                const std::vector<uint16_t> &batch_sizes)
+{
     this->output_data_queue = std::move(output_data_queue);
+
+    std::vector<uint16_t> sorted_batch_sizes(batch_sizes);
+    std::sort(sorted_batch_sizes.begin(), sorted_batch_sizes.end());
+    this->batch_configurations.clear();
+    for (uint16_t batch_size : sorted_batch_sizes) {
+        this->infer_model->set_batch_size(batch_size);
+        auto configured_exp = this->infer_model->configure();
+        if (!configured_exp) {
+            std::cerr << "Failed to configure batch size " << batch_size << ", status = " << configured_exp.status() << std::endl;
+            continue;
+        }
+
+        BatchConfiguration configuration;
+        configuration.batch_size = batch_size;
+        configuration.configured_infer_model = configured_exp.release();
+
+        size_t set_count = binding_set_count;
+        if (0 == set_count) {
+            // Twice the device queue: one half is in flight on the device while the other
+            // half still holds results that the postprocess thread has not consumed yet.
+            set_count = 2 * configuration.configured_infer_model.get_async_queue_size().expect("Failed to get async queue size");
+        }
+        configuration.binding_pool = std::make_shared<BindingSetPool>();
+        for (size_t i = 0; i < set_count; i++) {
+            configuration.binding_pool->add(create_binding_set(configuration.configured_infer_model));
+        }
+        this->batch_configurations.push_back(std::move(configuration));
+    }
+    if (this->batch_configurations.empty()) {
+        throw std::runtime_error("Failed to create configured infer model");
+    }
+    this->active_configuration = 0;
+}
+
+void AsyncModelInfer::select_batch_size(size_t pending_frames)
+{
+    size_t selected = 0;
+    for (size_t i = 0; i < batch_configurations.size(); i++) {
+        if (batch_configurations[i].batch_size <= std::max<size_t>(pending_frames, 1)) {
+            selected = i;
+        }
+    }
+    if (selected == active_configuration) {
+        return;
+    }
+
+    // Both configurations could be scheduled at once, but then a half-filled batch of the old one
+    // would wait for its timeout. Drain it first so the switch is clean and measurable.
+    auto start = std::chrono::steady_clock::now();
+    batch_configurations[active_configuration].binding_pool->wait_all_released();
+    double drain_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "-I- Switching device batch size " << batch_configurations[active_configuration].batch_size
+              << " -> " << batch_configurations[selected].batch_size
+              << " for " << pending_frames << " pending frames (drain " << drain_ms << " ms)" << std::endl;
+    {
+        std::lock_guard<std::mutex> lock(*switch_stats_mutex);
+        switch_stats->switch_count++;
+        switch_stats->last_drain_ms = drain_ms;
+        switch_stats->total_ms += drain_ms;
+    }
+    active_configuration = selected;
+    switch_started = std::chrono::steady_clock::now();
+    switch_pending = true;
+}
+
+uint16_t AsyncModelInfer::get_batch_size(){
+    return batch_configurations.empty() ? 0 : batch_configurations[active_configuration].batch_size;
+}
+
+BatchSwitchStats AsyncModelInfer::get_batch_switch_stats(){
+    std::lock_guard<std::mutex> lock(*switch_stats_mutex);
+    return *switch_stats;
+}
+
+SubmissionStats AsyncModelInfer::get_submission_stats(){
+    std::lock_guard<std::mutex> lock(*submission_stats_mutex);
+    return *submission_stats;
+}
+
+void AsyncModelInfer::set_submit_policy(const SubmitPolicy &policy){
+    this->submit_policy = policy;
+    this->submit_policy.max_attempts = std::max<size_t>(policy.max_attempts, 1);
 }
 
 std::shared_ptr<BoundedTSQueue<InferenceOutputItem>> AsyncModelInfer::get_queue(){
     return output_data_queue;
 }
 
+size_t AsyncModelInfer::get_binding_set_count(){
+    return batch_configurations.empty() ? 0 : batch_configurations[active_configuration].binding_pool->size();
+}
+
+size_t AsyncModelInfer::get_input_frame_size(){
+    return this->infer_model->inputs().front().get_frame_size();
+}
+
+hailo_3d_image_shape_t AsyncModelInfer::get_input_shape(){
+    return this->infer_model->inputs().front().shape();
+}
+
+std::vector<hailo_vstream_info_t> AsyncModelInfer::get_output_vstream_infos(){
+    std::vector<hailo_vstream_info_t> infos;
+    for (const auto &output_name : infer_model->get_output_names()) {
+        infos.push_back(output_vstream_info_by_name[output_name]);
+    }
+    return infos;
+}
+
 void AsyncModelInfer::infer(std::shared_ptr<std::vector<uint8_t>> input_data, size_t frame_idx) 
 {
-    set_input_buffers(input_data);
-    auto output_data_and_infos = prepare_output_buffers();
-    wait_and_run_async(frame_idx, output_data_and_infos);
+    const uint8_t *data = input_data->data();
+    infer(data, frame_idx, std::move(input_data));
 }
 
-void AsyncModelInfer::set_input_buffers(const std::shared_ptr<std::vector<uint8_t>> &input_data)
+void AsyncModelInfer::infer(const uint8_t *input_data, size_t frame_idx, std::shared_ptr<const void> input_guard)
 {
-    for (const auto &input_name : infer_model->get_input_names()) {
-        size_t frame_size = infer_model->input(input_name)->get_frame_size();
-        //std::cout<<frame_size<<std::endl;
+    infer(input_data, frame_idx, nullptr, std::move(input_guard));
+}
 
-        auto status = bindings.input(input_name)->set_buffer(MemoryView(input_data->data(), frame_size));
-        if (HAILO_SUCCESS != status) {
-            std::cerr << "Failed to set infer input buffer, status = " << status << std::endl;
-        }
-        input_buffer_guards.push_back(input_data);
-    }
+void AsyncModelInfer::infer(const uint8_t *input_data, size_t frame_idx, FrameCallback on_done,
+                            std::shared_ptr<const void> input_guard)
+{
+    auto binding_set = this->batch_configurations[this->active_configuration].binding_pool->acquire();
+    set_input_buffers(*binding_set, input_data, std::move(input_guard));
+    wait_and_run_async(frame_idx, std::move(binding_set), std::move(on_done));
 }
 
-std::vector<std::pair<uint8_t*, hailo_vstream_info_t>> AsyncModelInfer::prepare_output_buffers()
+BindingSet AsyncModelInfer::create_binding_set(hailort::ConfiguredInferModel &configured_infer_model)
 {
-    std::vector<std::pair<uint8_t*, hailo_vstream_info_t>> result;
+    BindingSet binding_set;
+    binding_set.bindings = configured_infer_model.create_bindings().expect("Failed to create infer bindings");
+
     for (const auto &output_name : infer_model->get_output_names()) {
         size_t frame_size = infer_model->output(output_name)->get_frame_size();
-        //size_t aligned_frame_size = align_to_page_size(frame_size);
-        output_data_holder = page_aligned_alloc(frame_size);
-        //std::cout <<frame_size<<std::endl;
-        auto status = bindings.output(output_name)->set_buffer(MemoryView(output_data_holder.get(), frame_size));
-
+        auto output_buffer = page_aligned_alloc(frame_size);
+        auto status = binding_set.bindings.output(output_name)->set_buffer(MemoryView(output_buffer.get(), frame_size));
         if (HAILO_SUCCESS != status) {
             std::cerr << "Failed to set infer output buffer, status = " << status << std::endl;
+            throw std::runtime_error("Failed to set infer output buffer");
         }
 
-        result.push_back(std::make_pair(
-            bindings.output(output_name)->get_buffer()->data(),
+        binding_set.output_data_and_infos.push_back(std::make_pair(
+            output_buffer.get(),
             output_vstream_info_by_name[output_name]
         ));
-
-        output_buffer_guards.push_back(output_data_holder);
+        binding_set.output_buffers.push_back(std::move(output_buffer));
     }
+    return binding_set;
+}
+
+void AsyncModelInfer::set_input_buffers(BindingSet &binding_set, const uint8_t *input_data, std::shared_ptr<const void> input_guard)
+{
+    for (const auto &input_name : infer_model->get_input_names()) {
+        size_t frame_size = infer_model->input(input_name)->get_frame_size();
 
-    return result;
+        // HailoRT only reads from input buffers, MemoryView just isn't const-qualified.
+        auto status = binding_set.bindings.input(input_name)->set_buffer(MemoryView(const_cast<uint8_t*>(input_data), frame_size));
+        if (HAILO_SUCCESS != status) {
+            std::cerr << "Failed to set infer input buffer, status = " << status << std::endl;
+        }
+    }
+    binding_set.input_guard = std::move(input_guard);
 }
 
 void AsyncModelInfer::clear()
 {
-    input_buffer_guards.clear();
-    output_buffer_guards.clear();
-    output_data_holder.reset(); // page_aligned_alloc 한 output_data도 초기화
+    // Every binding set must be back in its ring before the caller reuses its input memory.
+    for (auto &configuration : batch_configurations) {
+        configuration.binding_pool->wait_all_released();
+    }
 }
 
-void AsyncModelInfer::wait_and_run_async(size_t frame_idx,
-    const std::vector<std::pair<uint8_t*, hailo_vstream_info_t>> &output_data_and_infos)
+void AsyncModelInfer::wait_and_run_async(size_t frame_idx, std::shared_ptr<BindingSet> binding_set,
+                                         FrameCallback on_done)
 {
-    auto status = configured_infer_model.wait_for_async_ready(std::chrono::milliseconds(1000));
-    if (HAILO_SUCCESS != status) {
-        std::cerr << "Failed wait_for_async_ready, status = " << status << std::endl;
+    auto &configured_infer_model = this->batch_configurations[this->active_configuration].configured_infer_model;
+    if (this->switch_pending) {
+        // Time the first job on a new configuration: that is where the scheduler switch is paid.
+        this->switch_pending = false;
+        on_done = [on_done = std::move(on_done), queue = this->output_data_queue, start = this->switch_started,
+                   stats = this->switch_stats, stats_mutex = this->switch_stats_mutex](InferenceOutputItem &item) {
+            double first_frame_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            {
+                std::lock_guard<std::mutex> lock(*stats_mutex);
+                stats->last_first_frame_ms = first_frame_ms;
+                stats->total_ms += first_frame_ms;
+            }
+            std::cout << "-I- First frame after batch size switch: " << first_frame_ms << " ms" << std::endl;
+            if (on_done) {
+                on_done(item);
+            } else {
+                queue->push(std::move(item));
+            }
+        };
     }
+
     InferenceOutputItem item;
     item.frame_idx = frame_idx;
-    item.output_data_and_infos = output_data_and_infos;
+    item.output_data_and_infos = binding_set->output_data_and_infos;
+    item.buffer_guard = binding_set;
 
-    auto job = configured_infer_model.run_async(
-        bindings,
-        [this, item](const hailort::AsyncInferCompletionInfo& info)
-        {
-            get_queue()->push(item);
+    // Shared so a frame that never reaches the device can still be delivered from here.
+    auto deliver = std::make_shared<FrameCallback>(
+        [queue = this->output_data_queue, on_done = std::move(on_done),
+         stats = this->submission_stats, stats_mutex = this->submission_stats_mutex](InferenceOutputItem &item) {
+            {
+                std::lock_guard<std::mutex> lock(*stats_mutex);
+                if (HAILO_SUCCESS == item.status) {
+                    stats->completed++;
+                } else {
+                    stats->failed++;
+                }
+            }
+            if (on_done) {
+                on_done(item);
+            } else {
+                queue->push(item);
+            }
+            item.buffer_guard.reset(); // don't wait for HailoRT to destroy the callback to return the set
+        });
+    {
+        std::lock_guard<std::mutex> lock(*submission_stats_mutex);
+        submission_stats->submitted++;
+    }
+
+    auto backoff = submit_policy.retry_backoff;
+    hailo_status status = HAILO_SUCCESS;
+    for (size_t attempt = 1; attempt <= submit_policy.max_attempts; attempt++) {
+        if (attempt > 1) {
+            std::lock_guard<std::mutex> lock(*submission_stats_mutex);
+            submission_stats->retries++;
+        }
+        status = configured_infer_model.wait_for_async_ready(submit_policy.ready_timeout);
+        if (HAILO_SUCCESS == status) {
+            auto job = configured_infer_model.run_async(binding_set->bindings,
+                [deliver, item](const hailort::AsyncInferCompletionInfo &info) mutable {
+                    item.status = info.status;
+                    (*deliver)(item);
+                });
+            if (job) {
+                job->detach();
+                return;
+            }
+            status = job.status();
         }
-    );
 
-    if (!job) {
-        std::cerr << "Failed to start async infer job, status = " << job.status() << std::endl;
+        if (HAILO_TIMEOUT == status) {
+            std::lock_guard<std::mutex> lock(*submission_stats_mutex);
+            submission_stats->timeouts++;
+        }
+        // Only a full device is worth waiting for; anything else won't fix itself.
+        if (HAILO_TIMEOUT != status && HAILO_QUEUE_IS_FULL != status) {
+            break;
+        }
+        if (attempt < submit_policy.max_attempts) {
+            std::this_thread::sleep_for(backoff);
+            backoff *= 2;
+        }
     }
 
-    job->detach();
+    std::cerr << "Failed to start async infer job for frame " << frame_idx << ", status = " << status << std::endl;
+    item.status = status;
+    (*deliver)(item);
 }
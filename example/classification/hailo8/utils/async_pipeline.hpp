@@ -0,0 +1,133 @@
+#ifndef _ASYNC_PIPELINE_HPP_
+#define _ASYNC_PIPELINE_HPP_
+
+#include "ai_bmt_interface.h"
+#include "inference_backend.hpp"
+#include "worker_pool.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+// Returns the bytes behind one query without copying them. Raw pointer alternatives carry no length,
+// so raw_pointer_size (normally the backend's input_frame_size) is reported for them.
+inline std::pair<const uint8_t*, size_t> variant_bytes(const VariantType &item, size_t raw_pointer_size)
+{
+    return std::visit([raw_pointer_size](const auto &value) -> std::pair<const uint8_t*, size_t> {
+        using T = std::decay_t<decltype(value)>;
+        if constexpr (std::is_pointer_v<T>) {
+            return { reinterpret_cast<const uint8_t*>(value), raw_pointer_size };
+        } else {
+            return { reinterpret_cast<const uint8_t*>(value.data()), value.size() * sizeof(typename T::value_type) };
+        }
+    }, item);
+}
+
+struct PipelineStats {
+    size_t frames = 0;
+    size_t failed_frames = 0;
+    double seconds = 0.0;
+
+    double fps() const { return (seconds > 0.0) ? frames / seconds : 0.0; }
+};
+
+// Generic driver shared by every example: submits each query to an InferenceBackend with
+// backpressure, decodes each completion into the query's own BMTResult slot (so results are
+// ordered by frame_idx no matter the completion order) and waits until all frames are done.
+class AsyncPipeline {
+public:
+    // Turns one completed frame into a BMTResult. May run concurrently for different frames.
+    using DecodeFn = std::function<void(const InferenceCompletion &completion, BMTResult &result)>;
+
+private:
+    std::shared_ptr<InferenceBackend> m_backend;
+    std::unique_ptr<WorkerPool> m_decode_pool;
+
+public:
+    // decode_threads = 0 decodes on the backend's completion thread; use it only for cheap decodes
+    // (e.g. copying 1000 scores). Otherwise completions are handed to a pool of that many threads.
+    explicit AsyncPipeline(std::shared_ptr<InferenceBackend> backend, size_t decode_threads = 0)
+        : m_backend(std::move(backend))
+    {
+        if (decode_threads > 0) {
+            m_decode_pool = std::make_unique<WorkerPool>(decode_threads);
+        }
+    }
+
+    AsyncPipeline(const AsyncPipeline&) = delete;
+    AsyncPipeline& operator=(const AsyncPipeline&) = delete;
+
+    std::shared_ptr<InferenceBackend> backend() const { return m_backend; }
+    // nullptr when decoding inline. A DecodeFn may split its own work over this pool as long as it
+    // also works on it itself rather than only waiting (see decode_yolov5_parallel).
+    WorkerPool *decode_pool() const { return m_decode_pool.get(); }
+
+    PipelineStats run(const std::vector<VariantType> &data, std::vector<BMTResult> &results, const DecodeFn &decode)
+    {
+        auto start = std::chrono::steady_clock::now();
+        const size_t frame_count = data.size();
+        m_backend->hint_pending(frame_count);
+        const BackendCapabilities capabilities = m_backend->capabilities();
+        results.resize(frame_count);
+
+        CompletionLatch done(frame_count);
+        std::atomic<size_t> failed{0};
+
+        auto finish = [&results, &decode, &done, &failed](InferenceCompletion &completion) {
+            if (completion.ok() && completion.frame_idx < results.size()) {
+                try {
+                    decode(completion, results[completion.frame_idx]);
+                } catch (const std::exception &e) {
+                    std::cerr << "Failed to decode frame " << completion.frame_idx << ": " << e.what() << std::endl;
+                    failed++;
+                }
+            } else {
+                failed++;
+            }
+            completion.output_guard.reset();
+            done.count_down();
+        };
+
+        WorkerPool *decode_pool = m_decode_pool.get();
+        for (size_t i = 0; i < frame_count; i++) {
+            auto bytes = variant_bytes(data[i], capabilities.input_frame_size);
+            // The backends read input_frame_size bytes from the pointer; a shorter frame fails here
+            // instead of being read past its end.
+            if (!bytes.first || bytes.second < capabilities.input_frame_size) {
+                std::cerr << "-W- Frame " << i << " has " << bytes.second << " bytes, " << capabilities.name
+                          << " expects " << capabilities.input_frame_size << "; not submitted" << std::endl;
+                failed++;
+                done.count_down();
+                continue;
+            }
+            InferenceRequest request;
+            request.frame_idx = i;
+            request.input = bytes.first;
+            request.input_size = bytes.second;
+
+            m_backend->submit(std::move(request), [decode_pool, &finish](InferenceCompletion &completion) {
+                if (decode_pool) {
+                    decode_pool->post([&finish, completion]() mutable { finish(completion); });
+                } else {
+                    finish(completion);
+                }
+            });
+        }
+
+        done.wait();
+        m_backend->drain();
+
+        PipelineStats stats;
+        stats.frames = frame_count;
+        stats.failed_frames = failed.load();
+        stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return stats;
+    }
+};
+
+#endif /* _ASYNC_PIPELINE_HPP_ */
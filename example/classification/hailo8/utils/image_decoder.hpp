@@ -0,0 +1,279 @@
+#ifndef _IMAGE_DECODER_HPP_
+#define _IMAGE_DECODER_HPP_
+
+#include "worker_pool.hpp"
+
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Image decode for the preprocessing stage. Built with AI_BMT_HAVE_TURBOJPEG=1 (and linked against
+// libturbojpeg), a JPEG that is much larger than the target is decoded at 1/2, 1/4 or 1/8 scale in
+// the DCT domain: the smallest scale that still covers the target, so the remaining resize only
+// shrinks. The EXIF orientation is applied like cv::imread does, so both paths hand the model the
+// same upright image. Everything else (no libjpeg-turbo, not a JPEG, a broken file) goes through
+// cv::imread.
+// Every thread keeps its own decoder handle and file/pixel buffers, so the calls are thread-safe
+// and stop allocating once the image sizes repeat.
+#ifndef AI_BMT_HAVE_TURBOJPEG
+#define AI_BMT_HAVE_TURBOJPEG 0
+#endif
+
+#if AI_BMT_HAVE_TURBOJPEG
+#include <turbojpeg.h>
+#endif
+
+namespace image_decoder_detail {
+
+inline bool needs_resize(const cv::Mat &image, int target_w, int target_h)
+{
+    return target_w > 0 && target_h > 0 && (image.cols != target_w || image.rows != target_h);
+}
+
+inline void decode_opencv(const std::string &path, int target_w, int target_h, cv::Mat &out, int interpolation)
+{
+    cv::Mat image = cv::imread(path, cv::IMREAD_COLOR);
+    if (image.empty()) {
+        throw std::runtime_error("Failed to load image: " + path);
+    }
+    if (needs_resize(image, target_w, target_h)) {
+        cv::resize(image, out, cv::Size(target_w, target_h), 0, 0, interpolation);
+    } else {
+        out = image;
+    }
+}
+
+// Orientation tag (1-8) of a TIFF structure, i.e. the EXIF payload after "Exif\0\0"; 1 if absent.
+inline int tiff_orientation(const unsigned char *tiff, size_t size)
+{
+    if (size < 8) return 1;
+    const bool little = 'I' == tiff[0] && 'I' == tiff[1];
+    if (!little && !('M' == tiff[0] && 'M' == tiff[1])) return 1;
+    auto u16 = [&](size_t at) -> uint32_t {
+        return little ? (tiff[at] | tiff[at + 1] << 8) : (tiff[at] << 8 | tiff[at + 1]);
+    };
+    auto u32 = [&](size_t at) -> uint32_t {
+        return little ? (u16(at) | u16(at + 2) << 16) : (u16(at) << 16 | u16(at + 2));
+    };
+    const size_t ifd = u32(4);
+    if (ifd > size - 2) return 1;
+    const uint32_t entries = u16(ifd);
+    for (uint32_t i = 0; i < entries; ++i) {
+        const size_t entry = ifd + 2 + 12 * static_cast<size_t>(i);
+        if (entry + 12 > size) return 1;
+        if (0x0112 != u16(entry)) continue;
+        const uint32_t value = (3 == u16(entry + 2)) ? u16(entry + 8) : 1; // SHORT, left-justified
+        return (value >= 1 && value <= 8) ? static_cast<int>(value) : 1;
+    }
+    return 1;
+}
+
+// EXIF orientation of a JPEG file in memory; 1 (as stored) without an EXIF APP1 segment.
+inline int exif_orientation(const unsigned char *data, size_t size)
+{
+    if (size < 4 || 0xFF != data[0] || 0xD8 != data[1]) return 1;
+    size_t pos = 2;
+    while (pos + 4 <= size) {
+        if (0xFF != data[pos]) return 1;
+        const unsigned char marker = data[pos + 1];
+        if (0xFF == marker) { // fill byte
+            ++pos;
+            continue;
+        }
+        if (0xDA == marker || 0xD9 == marker) return 1; // scan data: no metadata from here on
+        const size_t length = static_cast<size_t>(data[pos + 2]) << 8 | data[pos + 3];
+        if (length < 2 || pos + 2 + length > size) return 1;
+        const unsigned char *segment = data + pos + 4;
+        if (0xE1 == marker && length - 2 >= 14 && 0 == std::memcmp(segment, "Exif\0\0", 6)) {
+            return tiff_orientation(segment + 6, length - 2 - 6);
+        }
+        pos += 2 + length;
+    }
+    return 1;
+}
+
+// Turns an image as stored into its upright view, the same flips/transposes cv::imread applies.
+inline void apply_exif_orientation(const cv::Mat &stored, int orientation, cv::Mat &out)
+{
+    static const int flips[9] = {0, 0, 1, -1, 0, 0, 1, -1, 0}; // cv::flip codes
+    if (orientation >= 5) {
+        cv::transpose(stored, out);
+        if (orientation > 5) cv::flip(out, out, flips[orientation]);
+    } else if (orientation > 1) {
+        cv::flip(stored, out, flips[orientation]);
+    } else {
+        stored.copyTo(out);
+    }
+}
+
+#if AI_BMT_HAVE_TURBOJPEG
+struct TurboDecoder {
+    tjhandle handle = tjInitDecompress();
+    std::vector<unsigned char> file;
+    cv::Mat scaled;
+    cv::Mat upright;
+
+    TurboDecoder() = default;
+    TurboDecoder(const TurboDecoder &) = delete;
+    TurboDecoder &operator=(const TurboDecoder &) = delete;
+    ~TurboDecoder() {
+        if (handle) tjDestroy(handle);
+    }
+};
+
+inline bool read_file(const std::string &path, std::vector<unsigned char> &bytes)
+{
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) return false;
+    const std::streamsize size = in.tellg();
+    if (size <= 0) return false;
+    in.seekg(0);
+    bytes.resize(static_cast<size_t>(size));
+    return static_cast<bool>(in.read(reinterpret_cast<char *>(bytes.data()), size));
+}
+
+// false: not something TurboJPEG can decode; the caller falls back to OpenCV.
+inline bool decode_turbo(const std::string &path, int target_w, int target_h, cv::Mat &out, int interpolation)
+{
+    thread_local TurboDecoder decoder;
+    if (!decoder.handle || !read_file(path, decoder.file)) return false;
+
+    int width = 0, height = 0, subsampling = 0, colorspace = 0;
+    if (0 != tjDecompressHeader3(decoder.handle, decoder.file.data(), static_cast<unsigned long>(decoder.file.size()),
+                                 &width, &height, &subsampling, &colorspace)) {
+        return false;
+    }
+
+    // Orientations 5-8 swap the sides, so the scale is picked against the target as stored.
+    const int orientation = exif_orientation(decoder.file.data(), decoder.file.size());
+    const bool transposed = orientation >= 5;
+    const int fit_w = transposed ? target_h : target_w;
+    const int fit_h = transposed ? target_w : target_h;
+    int scaled_w = width, scaled_h = height;
+    if (target_w > 0 && target_h > 0) {
+        int count = 0;
+        const tjscalingfactor *factors = tjGetScalingFactors(&count);
+        for (int i = 0; factors && i < count; ++i) {
+            if (factors[i].num > factors[i].denom) continue;
+            const int w = TJSCALED(width, factors[i]);
+            const int h = TJSCALED(height, factors[i]);
+            if (w >= fit_w && h >= fit_h && static_cast<long>(w) * h < static_cast<long>(scaled_w) * scaled_h) {
+                scaled_w = w;
+                scaled_h = h;
+            }
+        }
+    }
+
+    // Straight into out when neither a turn nor a resize follows, otherwise into this thread's
+    // scratch images.
+    const int upright_w = transposed ? scaled_h : scaled_w;
+    const int upright_h = transposed ? scaled_w : scaled_h;
+    const bool resize = target_w > 0 && target_h > 0 && (upright_w != target_w || upright_h != target_h);
+    cv::Mat &dst = (resize || 1 != orientation) ? decoder.scaled : out;
+    dst.create(scaled_h, scaled_w, CV_8UC3);
+    if (0 != tjDecompress2(decoder.handle, decoder.file.data(), static_cast<unsigned long>(decoder.file.size()), dst.data,
+                           scaled_w, static_cast<int>(dst.step), scaled_h, TJPF_BGR, 0) &&
+        TJERR_WARNING != tjGetErrorCode(decoder.handle)) {
+        return false;
+    }
+    if (1 != orientation) {
+        apply_exif_orientation(decoder.scaled, orientation, resize ? decoder.upright : out);
+    }
+    if (resize) {
+        cv::resize((1 != orientation) ? decoder.upright : decoder.scaled, out, cv::Size(target_w, target_h), 0, 0,
+                   interpolation);
+    }
+    return true;
+}
+#endif
+
+} // namespace image_decoder_detail
+
+// BGR image at target_w x target_h (0 x 0: as stored). out's buffer is reused when the size
+// matches. Throws if the file can't be decoded at all.
+inline void decode_image(const std::string &path, int target_w, int target_h, cv::Mat &out,
+                         int interpolation = cv::INTER_AREA)
+{
+#if AI_BMT_HAVE_TURBOJPEG
+    if (image_decoder_detail::decode_turbo(path, target_w, target_h, out, interpolation)) {
+        return;
+    }
+#endif
+    image_decoder_detail::decode_opencv(path, target_w, target_h, out, interpolation);
+}
+
+inline cv::Mat decode_image(const std::string &path, int target_w = 0, int target_h = 0,
+                            int interpolation = cv::INTER_AREA)
+{
+    cv::Mat image;
+    decode_image(path, target_w, target_h, image, interpolation);
+    return image;
+}
+
+// Decodes every path on pool plus the calling thread. on_decoded(index, image) runs on the
+// decoding thread, in no particular order, and may move the image out. Returns when all images
+// are done; if any decode threw, the first error is rethrown after that.
+inline void decode_images(const std::vector<std::string> &paths, int target_w, int target_h, WorkerPool &pool,
+                          const std::function<void(size_t, cv::Mat &)> &on_decoded,
+                          int interpolation = cv::INTER_AREA)
+{
+    // paths and on_decoded stay on the caller's stack: a helper that starts after the last image
+    // was claimed only sees next >= count and never touches them.
+    struct Job {
+        size_t count;
+        const std::vector<std::string> *paths;
+        int target_w;
+        int target_h;
+        int interpolation;
+        const std::function<void(size_t, cv::Mat &)> *on_decoded;
+        std::atomic<size_t> next{0};
+        std::mutex error_mutex;
+        std::exception_ptr error;
+        CompletionLatch done;
+        explicit Job(size_t image_count) : count(image_count), done(image_count) {}
+
+        void run() {
+            for (size_t i = next++; i < count; i = next++) {
+                try {
+                    cv::Mat image;
+                    decode_image((*paths)[i], target_w, target_h, image, interpolation);
+                    (*on_decoded)(i, image);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(error_mutex);
+                    if (!error) error = std::current_exception();
+                }
+                done.count_down();
+            }
+        }
+    };
+
+    if (paths.empty()) return;
+    auto job = std::make_shared<Job>(paths.size());
+    job->paths = &paths;
+    job->target_w = target_w;
+    job->target_h = target_h;
+    job->interpolation = interpolation;
+    job->on_decoded = &on_decoded;
+
+    const size_t helpers = std::min(pool.size(), paths.size() - 1);
+    for (size_t i = 0; i < helpers; ++i) {
+        pool.post([job] { job->run(); });
+    }
+    job->run();
+    job->done.wait();
+    if (job->error) std::rethrow_exception(job->error);
+}
+
+#endif /* _IMAGE_DECODER_HPP_ */
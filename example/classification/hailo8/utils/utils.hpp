@@ -32,6 +32,9 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <mutex>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 
 #include <opencv2/highgui.hpp>
 #include <opencv2/core/matx.hpp>
@@ -42,6 +45,7 @@
 
 #include "hailo/infer_model.hpp" 
 #include "hailo/hailort.h"
+#include "label_type.h"
 
 
 
@@ -73,7 +77,8 @@ struct PreprocessedFrameItem {
 struct InferenceOutputItem {
     size_t frame_idx;  
     std::vector<std::pair<uint8_t*, hailo_vstream_info_t>> output_data_and_infos;
-    
+    std::shared_ptr<void> buffer_guard; // keeps the binding set that owns the outputs out of the ring until consumed
+    hailo_status status = HAILO_SUCCESS; // anything else: the outputs hold no valid data for this frame
 };
 
 struct NamedBbox {
@@ -142,6 +147,14 @@ void draw_label(cv::Mat &frame, const std::string &label, const cv::Point &top_l
 void draw_single_bbox(cv::Mat &frame, const NamedBbox &named_bbox, const cv::Scalar &color);
 void draw_bounding_boxes(cv::Mat &frame, const std::vector<NamedBbox> &bboxes);
 std::vector<NamedBbox> parse_nms_data(uint8_t *data, size_t max_class_count);
+// HailoRT NMS-by-class buffer (per class: float count, then count hailo_bbox_float32_t) straight
+// into detections, boxes scaled from normalized to org_width x org_height pixels and classIndex
+// 0-based. detections is cleared but keeps its capacity, so reusing it across frames makes the
+// parse allocation-free once warmed up. Reads stop at data_size bytes or max_detections boxes.
+// Returns the number of detections.
+size_t parse_nms_data(const uint8_t *data, size_t data_size, size_t max_class_count,
+                      int org_width, int org_height, std::vector<Coco17DetectionResult> &detections,
+                      size_t max_detections = SIZE_MAX);
 
 // ─────────────────────────────────────────────────────────────────────────────
 // HELPERS
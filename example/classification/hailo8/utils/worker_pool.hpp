@@ -0,0 +1,114 @@
+#ifndef _WORKER_POOL_HPP_
+#define _WORKER_POOL_HPP_
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Fixed set of threads that run posted tasks in FIFO order.
+// Used to move postprocessing off the inference completion thread.
+class WorkerPool {
+private:
+    std::vector<std::thread> m_threads;
+    std::queue<std::function<void()>> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_cond_task;
+    std::condition_variable m_cond_idle;
+    size_t m_busy = 0;
+    bool m_stopped = false;
+
+    void worker_loop() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cond_task.wait(lock, [this] { return !m_tasks.empty() || m_stopped; });
+                if (m_tasks.empty()) {
+                    return;
+                }
+                task = std::move(m_tasks.front());
+                m_tasks.pop();
+                m_busy++;
+            }
+            task();
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_busy--;
+                if (m_tasks.empty() && 0 == m_busy) {
+                    m_cond_idle.notify_all();
+                }
+            }
+        }
+    }
+
+public:
+    explicit WorkerPool(size_t thread_count) {
+        if (0 == thread_count) {
+            thread_count = 1;
+        }
+        m_threads.reserve(thread_count);
+        for (size_t i = 0; i < thread_count; i++) {
+            m_threads.emplace_back(&WorkerPool::worker_loop, this);
+        }
+    }
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopped = true;
+        }
+        m_cond_task.notify_all();
+        for (auto &thread : m_threads) {
+            thread.join();
+        }
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    void post(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_tasks.push(std::move(task));
+        }
+        m_cond_task.notify_one();
+    }
+
+    // Blocks until the queue is empty and no task is running.
+    void wait_idle() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cond_idle.wait(lock, [this] { return m_tasks.empty() && 0 == m_busy; });
+    }
+
+    size_t size() const { return m_threads.size(); }
+};
+
+// Counts outstanding frames down to zero; wait() returns once every frame has reported.
+class CompletionLatch {
+private:
+    size_t m_pending;
+    std::mutex m_mutex;
+    std::condition_variable m_cond_done;
+
+public:
+    explicit CompletionLatch(size_t count) : m_pending(count) {}
+
+    CompletionLatch(const CompletionLatch&) = delete;
+    CompletionLatch& operator=(const CompletionLatch&) = delete;
+
+    void count_down() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_pending > 0 && 0 == --m_pending) {
+            m_cond_done.notify_all();
+        }
+    }
+    void wait() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cond_done.wait(lock, [this] { return 0 == m_pending; });
+    }
+};
+
+#endif /* _WORKER_POOL_HPP_ */
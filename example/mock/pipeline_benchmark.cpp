@@ -0,0 +1,803 @@
+// Runs the AsyncPipeline against the simulated accelerator so the CPU side of the
+// pipeline (submission, buffer rings, decode) can be benchmarked on any Linux box.
+//
+//   ./run_mock_benchmark -model=yolov5 -frames=500 -engines=2 -queue=4 -service_us=8000 -jitter=normal -jitter_us=500
+//
+// -devices=N puts N simulated accelerators behind a MultiDeviceBackend to check scale-out.
+// -verify_decode checks the SIMD YOLOv5 decode and the sigmoid approximations against the scalar
+// reference, checks the row-band parallel decode against the serial one, checks the fused
+// postprocess against threshold + NMS on the fully decoded tensor, checks every decoder of
+// detection_decoders.hpp against the same threshold + NMS on synthetic tensors, times each
+// variant and exits.
+// -verify_preprocess checks the fused BGR -> normalized CHW kernel (float and fp16) against the
+// separate cvtColor / convertTo / normalize / transpose passes it replaces, and the letterbox
+// resize against a float bilinear reference, times them and exits. Built with OpenCV, it also
+// checks decode_image (TurboJPEG when found) against cv::imread on EXIF-oriented JPEGs.
+// -postprocess=fused runs the fused postprocess in the yolov5 pipeline instead of the full decode.
+#include "ai_bmt_interface.h"
+#include "utils/async_pipeline.hpp"
+#include "utils/detection_decoders.hpp"
+#include "utils/image_preprocess.hpp"
+#include "utils/letterbox.hpp"
+#include "utils/mock_backend.hpp"
+#include "utils/multi_device_backend.hpp"
+#include "utils/yolo_decode.hpp"
+#include "utils/yolo_postprocess.hpp"
+
+#ifndef AI_BMT_MOCK_HAVE_OPENCV
+#define AI_BMT_MOCK_HAVE_OPENCV 0
+#endif
+#if AI_BMT_MOCK_HAVE_OPENCV
+#include "utils/image_decoder.hpp"
+#include <filesystem>
+#include <fstream>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+
+using namespace std;
+
+static string getCmdOption(int argc, char *argv[], const string &option, const string &default_value)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        if (0 == arg.find(option))
+            return arg.substr(option.size());
+    }
+    return default_value;
+}
+
+static MockJitter parse_jitter(const string &name)
+{
+    if (name == "uniform")
+        return MockJitter::UNIFORM;
+    if (name == "normal")
+        return MockJitter::NORMAL;
+    if (name == "exp")
+        return MockJitter::EXPONENTIAL;
+    return MockJitter::NONE;
+}
+
+static const float YOLOV5_ANCHORS[3][3][2] = {
+    {{10, 13}, {16, 30}, {33, 23}},
+    {{30, 61}, {62, 45}, {59, 119}},
+    {{116, 90}, {156, 198}, {373, 326}}};
+
+static vector<YoloV5Head> yolov5_heads(const vector<TensorView> &outputs)
+{
+    vector<YoloV5Head> heads(outputs.size());
+    for (size_t i = 0; i < outputs.size(); i++)
+    {
+        heads[i].data = reinterpret_cast<const float *>(outputs[i].data);
+        heads[i].grid_h = static_cast<int>(outputs[i].shape.dims[1]);
+        heads[i].grid_w = static_cast<int>(outputs[i].shape.dims[2]);
+        heads[i].cell_stride = static_cast<int>(outputs[i].shape.dims[3]);
+        heads[i].stride = 640.0f / heads[i].grid_w;
+        memcpy(heads[i].anchors, YOLOV5_ANCHORS[min<size_t>(i, 2)], sizeof(heads[i].anchors));
+    }
+    return heads;
+}
+
+// Logits shaped like a real frame: objectness is low almost everywhere, ~1% of the rows are objects.
+// Class logits stay below 8 so no two classes round to the same float after the sigmoid, which
+// would make the best class of a row ambiguous.
+static vector<TensorView> realistic_yolov5_logits(vector<vector<float>> &buffers, mt19937 &rng)
+{
+    uniform_real_distribution<float> logit(-12.0f, 8.0f), background(-12.0f, -3.0f), object(-1.0f, 6.0f);
+    uniform_real_distribution<float> box(-2.0f, 2.0f), chance(0.0f, 1.0f);
+    vector<TensorView> outputs;
+    for (int grid : {80, 40, 20})
+    {
+        buffers.emplace_back(static_cast<size_t>(grid) * grid * 255);
+        float *row = buffers.back().data();
+        for (size_t r = 0; r < static_cast<size_t>(grid) * grid * 3; r++, row += YOLOV5_ATTRIBUTES)
+        {
+            for (int c = 0; c < 4; c++)
+                row[c] = box(rng);
+            row[4] = (chance(rng) < 0.01f) ? object(rng) : background(rng);
+            for (int c = 5; c < YOLOV5_ATTRIBUTES; c++)
+                row[c] = logit(rng);
+        }
+        TensorView view;
+        view.data = reinterpret_cast<const uint8_t *>(buffers.back().data());
+        view.shape = TensorShape{1, grid, grid, 255};
+        outputs.push_back(view);
+    }
+    return outputs;
+}
+
+static bool verify_yolov5_postprocess()
+{
+    mt19937 rng(99);
+    vector<vector<float>> buffers;
+    auto heads = yolov5_heads(realistic_yolov5_logits(buffers, rng));
+    bool ok = true;
+    for (bool multi_label : {true, false})
+    {
+        DetectionOptions options;
+        options.apply_sigmoid = true;
+        options.multi_label = multi_label;
+
+        const int repeats = 20;
+        vector<float> decoded;
+        vector<Coco17DetectionResult> reference, fused;
+        auto start = chrono::steady_clock::now();
+        for (int r = 0; r < repeats; r++)
+        {
+            decode_yolov5(heads, true, decoded);
+            detect_from_yolov5_rows(decoded.data(), decoded.size() / YOLOV5_ATTRIBUTES, options, reference);
+        }
+        double full_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / repeats;
+        start = chrono::steady_clock::now();
+        for (int r = 0; r < repeats; r++)
+            detect_yolov5(heads, options, fused);
+        double fused_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / repeats;
+
+        bool same = reference.size() == fused.size();
+        for (size_t i = 0; same && i < fused.size(); i++)
+        {
+            same = reference[i].classIndex == fused[i].classIndex &&
+                   fabs(reference[i].confidence - fused[i].confidence) < 1e-5f &&
+                   fabs(reference[i].top_left_x - fused[i].top_left_x) < 1e-2f &&
+                   fabs(reference[i].top_left_y - fused[i].top_left_y) < 1e-2f &&
+                   fabs(reference[i].width - fused[i].width) < 1e-2f &&
+                   fabs(reference[i].height - fused[i].height) < 1e-2f;
+        }
+        ok = ok && same;
+        cout << "-I- YOLOv5 postprocess (" << (multi_label ? "multi-label" : "best class ") << "): full decode + NMS " << full_ms
+             << " ms/frame, fused " << fused_ms << " ms/frame, " << fused.size() << " detections, "
+             << (same ? "same detections" : "DIFFERENT detections  <-- FAILED") << endl;
+    }
+    return ok;
+}
+
+// Compared in confidence order: classes and scores exactly (to float rounding), boxes to 1/100 px.
+static bool same_detections(vector<Coco17DetectionResult> a, vector<Coco17DetectionResult> b)
+{
+    auto by_confidence = [](const Coco17DetectionResult &x, const Coco17DetectionResult &y) { return x.confidence > y.confidence; };
+    stable_sort(a.begin(), a.end(), by_confidence);
+    stable_sort(b.begin(), b.end(), by_confidence);
+    bool same = a.size() == b.size();
+    for (size_t i = 0; same && i < a.size(); i++)
+    {
+        same = a[i].classIndex == b[i].classIndex && fabs(a[i].confidence - b[i].confidence) < 1e-5f &&
+               fabs(a[i].top_left_x - b[i].top_left_x) < 1e-2f && fabs(a[i].top_left_y - b[i].top_left_y) < 1e-2f &&
+               fabs(a[i].width - b[i].width) < 1e-2f && fabs(a[i].height - b[i].height) < 1e-2f;
+    }
+    return same;
+}
+
+// What the harness sees from FUSED_POSTPROCESS: the fused detections written as rows, thresholded
+// and NMS'd again at the harness's 0.001, must be what it gets from the fully decoded tensor. A
+// default threshold above the harness's would drop boxes here.
+static bool verify_fused_rows_at_harness_threshold()
+{
+    mt19937 rng(5);
+    vector<vector<float>> buffers;
+    auto heads = yolov5_heads(realistic_yolov5_logits(buffers, rng));
+    DetectionOptions harness;
+    harness.conf_threshold = 0.001f;
+
+    vector<float> decoded, rows;
+    vector<Coco17DetectionResult> reference, fused, from_rows;
+    decode_yolov5(heads, true, decoded);
+    detect_from_yolov5_rows(decoded.data(), decoded.size() / YOLOV5_ATTRIBUTES, harness, reference);
+    detect_yolov5(heads, DetectionOptions(), fused);
+    write_detections_as_yolov5_rows(fused, decoded.size() / YOLOV5_ATTRIBUTES, rows);
+    detect_from_yolov5_rows(rows.data(), rows.size() / YOLOV5_ATTRIBUTES, harness, from_rows);
+
+    const bool same = same_detections(from_rows, reference);
+    cout << "-I- YOLOv5 fused rows at the harness threshold: " << from_rows.size() << " of " << reference.size()
+         << " detections, " << (same ? "same detections" : "DIFFERENT detections  <-- FAILED") << endl;
+    return same;
+}
+
+// Native uint8/uint16 heads (sigmoid outputs, as a Hailo HEF delivers them) against float heads
+// holding the same dequantized values: the decode and the fused postprocess must agree.
+static bool verify_quantized_decode()
+{
+    mt19937 rng(7);
+    vector<vector<float>> buffers;
+    auto float_heads = yolov5_heads(realistic_yolov5_logits(buffers, rng));
+    for (auto &buffer : buffers)
+    {
+        for (float &v : buffer)
+            v = 1.0f / (1.0f + exp(-v));
+    }
+
+    bool ok = true;
+    for (YoloV5HeadFormat format : {YoloV5HeadFormat::UINT8, YoloV5HeadFormat::UINT16})
+    {
+        const bool u8 = format == YoloV5HeadFormat::UINT8;
+        const float levels = u8 ? 255.0f : 65535.0f;
+        vector<vector<uint8_t>> quantized;
+        vector<vector<float>> dequantized;
+        auto quant_heads = float_heads, reference_heads = float_heads;
+        for (size_t h = 0; h < float_heads.size(); h++)
+        {
+            const vector<float> &values = buffers[h];
+            quantized.emplace_back(values.size() * (u8 ? 1 : 2));
+            dequantized.emplace_back(values.size());
+            for (size_t i = 0; i < values.size(); i++)
+            {
+                uint16_t q = static_cast<uint16_t>(lround(values[i] * levels));
+                if (u8)
+                    quantized.back()[i] = static_cast<uint8_t>(q);
+                else
+                    memcpy(quantized.back().data() + 2 * i, &q, 2);
+                dequantized.back()[i] = (static_cast<float>(q) - 0.0f) * (1.0f / levels);
+            }
+            quant_heads[h].data = quantized.back().data();
+            quant_heads[h].format = format;
+            quant_heads[h].scale = 1.0f / levels;
+            quant_heads[h].zero_point = 0.0f;
+            reference_heads[h].data = dequantized.back().data();
+        }
+
+        vector<float> reference, fused;
+        decode_yolov5(reference_heads, false, reference);
+        const int repeats = 20;
+        auto start = chrono::steady_clock::now();
+        for (int r = 0; r < repeats; r++)
+            decode_yolov5(quant_heads, false, fused);
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / repeats;
+        double max_rel = 0.0;
+        for (size_t i = 0; i < fused.size() && i < reference.size(); i++)
+            max_rel = max(max_rel, fabs(static_cast<double>(fused[i]) - reference[i]) / max(1.0, fabs(static_cast<double>(reference[i]))));
+
+        DetectionOptions options;
+        options.apply_sigmoid = false;
+        vector<Coco17DetectionResult> reference_dets, quant_dets;
+        detect_yolov5(reference_heads, options, reference_dets);
+        detect_yolov5(quant_heads, options, quant_dets);
+        bool same = reference_dets.size() == quant_dets.size();
+        for (size_t i = 0; same && i < quant_dets.size(); i++)
+            same = reference_dets[i].classIndex == quant_dets[i].classIndex && reference_dets[i].confidence == quant_dets[i].confidence;
+
+        size_t bytes = 0;
+        for (const auto &q : quantized)
+            bytes += q.size();
+        bool format_ok = fused.size() == reference.size() && max_rel < 1e-6 && same;
+        ok = ok && format_ok;
+        cout << "-I- YOLOv5 decode (" << (u8 ? "uint8 " : "uint16") << " heads, fused dequantize): " << ms << " ms/frame, "
+             << bytes / 1024 << " KiB/frame vs " << bytes * (u8 ? 4 : 2) / 1024 << " KiB as float, max rel. error " << max_rel
+             << ", " << quant_dets.size() << " detections" << (format_ok ? "" : "  <-- FAILED") << endl;
+    }
+    return ok;
+}
+
+// Every decoder create_detection_decoder can pick, on a synthetic output, against
+// detect_from_yolov5_rows on the same candidates written as [cx, cy, w, h, obj, scores] rows.
+static bool verify_detection_decoders()
+{
+    mt19937 rng(21);
+    uniform_real_distribution<float> unit(0.0f, 1.0f), logit(-8.0f, 6.0f), background(-12.0f, -3.0f), object(-1.0f, 6.0f);
+    uniform_real_distribution<float> box(-2.0f, 2.0f), position(0.0f, 640.0f), extent(4.0f, 200.0f);
+    const DetectionOptions options;
+    bool ok = true;
+    auto check = [&ok, &options](const DetectionDecoder &decoder, const vector<const float *> &outputs,
+                                 const vector<float> &rows, int classes, const DetectionOptions &reference_options)
+    {
+        vector<Coco17DetectionResult> decoded, reference;
+        decoder.detect(outputs, options, decoded);
+        detect_from_yolov5_rows(rows.data(), rows.size() / (5 + classes), reference_options, reference, classes);
+        const bool same = same_detections(decoded, reference);
+        ok = ok && same;
+        cout << "-I- Detection decoder " << decoder.name() << ": " << decoded.size() << " detections, "
+             << (same ? "same as YOLOv5 rows" : "DIFFERENT from YOLOv5 rows  <-- FAILED") << endl;
+    };
+
+    // Raw grid heads (logits), listed coarsest first, at two input sizes and class counts; the
+    // COCO heads are padded to 256 channels like the DeepX outputs.
+    for (int input : {640, 320})
+    {
+        const int classes = (640 == input) ? 80 : 20, attributes = 5 + classes;
+        const int channels = 3 * attributes + ((640 == input) ? 1 : 0);
+        vector<vector<float>> heads;
+        vector<vector<int64_t>> shapes;
+        vector<float> rows;
+        for (int level = 2; level >= 0; level--)
+        {
+            const int stride = YoloV5Anchors::strides[level], grid = input / stride;
+            heads.emplace_back(static_cast<size_t>(grid) * grid * channels);
+            shapes.push_back({1, grid, grid, channels});
+            for (int y = 0; y < grid; y++)
+                for (int x = 0; x < grid; x++)
+                    for (int a = 0; a < 3; a++)
+                    {
+                        float *raw = heads.back().data() + (static_cast<size_t>(y) * grid + x) * channels + a * attributes;
+                        for (int c = 0; c < 4; c++)
+                            raw[c] = box(rng);
+                        raw[4] = (unit(rng) < 0.01f) ? object(rng) : background(rng);
+                        for (int c = 5; c < attributes; c++)
+                            raw[c] = logit(rng);
+                        auto sigmoid = [](float v) { return fast_math::sigmoid(v); };
+                        const float tx = 2 * sigmoid(raw[0]), ty = 2 * sigmoid(raw[1]), tw = 2 * sigmoid(raw[2]), th = 2 * sigmoid(raw[3]);
+                        rows.push_back((tx - 0.5f + x) * stride);
+                        rows.push_back((ty - 0.5f + y) * stride);
+                        rows.push_back(tw * tw * YoloV5Anchors::anchors[level][a][0]);
+                        rows.push_back(th * th * YoloV5Anchors::anchors[level][a][1]);
+                        for (int c = 4; c < attributes; c++)
+                            rows.push_back(sigmoid(raw[c]));
+                    }
+        }
+        auto decoder = create_detection_decoder(shapes, input, input);
+        check(*decoder, {heads[0].data(), heads[1].data(), heads[2].data()}, rows, classes, options);
+    }
+
+    // {1, 25200, 5 + C}, already activated, for COCO and a 20-class model.
+    for (int classes : {80, 20})
+    {
+        const size_t count = yolov5_row_count(640, 640);
+        vector<float> rows;
+        for (size_t r = 0; r < count; r++)
+        {
+            rows.insert(rows.end(), {position(rng), position(rng), extent(rng), extent(rng), (unit(rng) < 0.02f) ? unit(rng) : 0.1f * unit(rng)});
+            for (int c = 0; c < classes; c++)
+                rows.push_back(unit(rng));
+        }
+        auto decoder = create_detection_decoder({{1, static_cast<int64_t>(count), 5 + classes}}, 640, 640);
+        check(*decoder, {rows.data()}, rows, classes, options);
+    }
+
+    // Anchor-free {1, 84, 8400} and {1, 8400, 84}: rows with objectness 1 score the same.
+    const size_t candidates = 8400;
+    vector<float> v8_rows, v8_transposed(84 * candidates), v8_row_major;
+    for (size_t i = 0; i < candidates; i++)
+    {
+        const bool object = unit(rng) < 0.01f;
+        float values[84];
+        for (int k = 0; k < 4; k++)
+            values[k] = (k < 2) ? position(rng) : extent(rng);
+        for (int c = 0; c < 80; c++)
+            values[4 + c] = object ? unit(rng) : 0.05f * unit(rng);
+        v8_row_major.insert(v8_row_major.end(), values, values + 84);
+        for (int k = 0; k < 84; k++)
+            v8_transposed[k * candidates + i] = values[k];
+        v8_rows.insert(v8_rows.end(), values, values + 4);
+        v8_rows.push_back(1.0f);
+        v8_rows.insert(v8_rows.end(), values + 4, values + 84);
+    }
+    check(*create_detection_decoder({{1, 84, static_cast<int64_t>(candidates)}}, 640, 640), {v8_transposed.data()}, v8_rows, 80, options);
+    check(*create_detection_decoder({{1, static_cast<int64_t>(candidates), 84}}, 640, 640), {v8_row_major.data()}, v8_rows, 80, options);
+
+    // NMS-free {1, 300, 6}: one-hot class rows, and no NMS on the reference side either.
+    vector<float> v10, v10_rows;
+    for (int r = 0; r < 300; r++)
+    {
+        const float x1 = position(rng), y1 = position(rng), w = extent(rng), h = extent(rng), score = unit(rng);
+        const int cls = static_cast<int>(unit(rng) * 79.99f);
+        v10.insert(v10.end(), {x1, y1, x1 + w, y1 + h, score, static_cast<float>(cls)});
+        v10_rows.insert(v10_rows.end(), {x1 + 0.5f * w, y1 + 0.5f * h, w, h, 1.0f});
+        for (int c = 0; c < 80; c++)
+            v10_rows.push_back((c == cls) ? score : 0.0f);
+    }
+    DetectionOptions no_nms = options;
+    no_nms.iou_threshold = 2.0f;
+    check(*create_detection_decoder({{1, 300, 6}}, 640, 640), {v10.data()}, v10_rows, 80, no_nms);
+
+    // Only COCO classes fit the harness rows; others (e.g. from a 91-class NMS head) are dropped.
+    vector<float> written;
+    write_detections_as_yolov5_rows({{-1, 0, 0, 8, 8, 0.9f}, {80, 0, 0, 8, 8, 0.9f}, {79, 0, 0, 8, 8, 0.8f}}, 2, written);
+    const bool dropped = written[5 + 79] == 0.8f && written[YOLOV5_ATTRIBUTES + 4] == 0.0f;
+    ok = ok && dropped;
+    cout << "-I- YOLOv5 rows from detections: out-of-range classes " << (dropped ? "dropped" : "NOT dropped  <-- FAILED") << endl;
+    return ok;
+}
+
+// Decodes random logits with both paths and reports the largest difference. Boxes are compared
+// relative to their magnitude (up to ~640 px), scores absolutely.
+static int verify_yolov5_decode()
+{
+    mt19937 rng(1234);
+    uniform_real_distribution<float> logit(-12.0f, 12.0f);
+    vector<vector<float>> buffers;
+    vector<TensorView> outputs;
+    for (int grid : {80, 40, 20})
+    {
+        const int cell_stride = (grid == 40) ? 256 : 255; // one head padded like the DeepX outputs
+        buffers.emplace_back(static_cast<size_t>(grid) * grid * cell_stride);
+        for (float &v : buffers.back())
+            v = logit(rng);
+        TensorView view;
+        view.data = reinterpret_cast<const uint8_t *>(buffers.back().data());
+        view.shape = TensorShape{1, grid, grid, cell_stride};
+        outputs.push_back(view);
+    }
+    auto heads = yolov5_heads(outputs);
+
+    struct Variant
+    {
+        const char *name;
+        bool apply_sigmoid;
+        SigmoidApprox approx;
+        double score_tolerance;
+    };
+    // Documented bounds from fast_math.hpp, plus a little for comparing against float std::exp.
+    // The vector decode runs POLY for LUT.
+    const Variant variants[] = {
+        {"logits, exact sigmoid", true, SigmoidApprox::EXACT, 1e-6},
+        {"logits, poly sigmoid ", true, SigmoidApprox::POLY, 2.5e-5},
+        {"logits, LUT sigmoid  ", true, SigmoidApprox::LUT, SIMD_MATH_ENABLED ? 2.5e-5 : 3.5e-6},
+        {"sigmoid outputs      ", false, SigmoidApprox::EXACT, 0.0}};
+
+    vector<float> reference_logits, reference_activated;
+    for (bool apply_sigmoid : {true, false})
+    {
+        vector<float> &reference = apply_sigmoid ? reference_logits : reference_activated;
+        size_t rows = 0;
+        for (const auto &head : heads)
+            rows += head.rows();
+        reference.resize(rows * YOLOV5_ATTRIBUTES);
+        float *out = reference.data();
+        for (const auto &head : heads)
+        {
+            decode_yolov5_head_scalar(head, apply_sigmoid, out);
+            out += head.rows() * YOLOV5_ATTRIBUTES;
+        }
+    }
+
+    WorkerPool tile_pool(3);
+    bool ok = true;
+    for (const Variant &variant : variants)
+    {
+        const vector<float> &reference = variant.apply_sigmoid ? reference_logits : reference_activated;
+        vector<float> fast;
+        const int repeats = 20;
+        auto start = chrono::steady_clock::now();
+        for (int r = 0; r < repeats; r++)
+            decode_yolov5(heads, variant.apply_sigmoid, fast, variant.approx);
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / repeats;
+
+        double max_box_rel = 0.0, max_score_abs = 0.0;
+        for (size_t i = 0; i < fast.size(); i++)
+        {
+            double diff = fabs(static_cast<double>(fast[i]) - reference[i]);
+            if (i % YOLOV5_ATTRIBUTES < 4)
+                max_box_rel = max(max_box_rel, diff / max(1.0, fabs(static_cast<double>(reference[i]))));
+            else
+                max_score_abs = max(max_score_abs, diff);
+        }
+        bool variant_ok = max_box_rel < 1e-6 && max_score_abs <= variant.score_tolerance;
+        ok = ok && variant_ok;
+        cout << "-I- YOLOv5 decode (" << variant.name << ", " << (SIMD_MATH_ENABLED ? "SIMD" : "scalar")
+             << "): " << ms << " ms/frame, max box rel. error " << max_box_rel
+             << ", max score abs. error " << max_score_abs << (variant_ok ? "" : "  <-- FAILED") << endl;
+
+        vector<float> tiled;
+        start = chrono::steady_clock::now();
+        for (int r = 0; r < repeats; r++)
+            decode_yolov5_parallel(heads, variant.apply_sigmoid, tiled, tile_pool, variant.approx);
+        ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / repeats;
+        bool identical = tiled.size() == fast.size() && 0 == memcmp(tiled.data(), fast.data(), fast.size() * sizeof(float));
+        ok = ok && identical;
+        cout << "-I-   row bands on " << tile_pool.size() + 1 << " threads: " << ms << " ms/frame, "
+             << (identical ? "identical to serial" : "DIFFERS from serial  <-- FAILED") << endl;
+    }
+
+    // A letterbox undone inside the decode must match mapping the reference boxes afterwards.
+    const BoxMapping boxes{0.75f, 1.25f, -12.0f, -80.0f};
+    auto mapped_heads = heads;
+    for (auto &head : mapped_heads)
+        head.map_boxes(boxes.scale_x, boxes.scale_y, boxes.offset_x, boxes.offset_y);
+    vector<float> mapped;
+    decode_yolov5(mapped_heads, false, mapped);
+    double max_mapped_rel = 0.0;
+    for (size_t row = 0; row * YOLOV5_ATTRIBUTES < mapped.size(); row++)
+    {
+        const float *in = reference_activated.data() + row * YOLOV5_ATTRIBUTES;
+        const float expected[4] = {in[0] * boxes.scale_x + boxes.offset_x, in[1] * boxes.scale_y + boxes.offset_y,
+                                   in[2] * boxes.scale_x, in[3] * boxes.scale_y};
+        for (int k = 0; k < 4; k++)
+            max_mapped_rel = max(max_mapped_rel, fabs(static_cast<double>(mapped[row * YOLOV5_ATTRIBUTES + k]) - expected[k]) /
+                                                     max(1.0, fabs(static_cast<double>(expected[k]))));
+    }
+    const bool mapped_ok = max_mapped_rel < 1e-5;
+    ok = ok && mapped_ok;
+    cout << "-I- YOLOv5 decode with box mapping: max box rel. error " << max_mapped_rel << (mapped_ok ? "" : "  <-- FAILED") << endl;
+
+    ok = verify_yolov5_postprocess() && ok;
+    ok = verify_fused_rows_at_harness_threshold() && ok;
+    ok = verify_quantized_decode() && ok;
+    ok = verify_detection_decoders() && ok;
+    return ok ? 0 : 1;
+}
+
+static float half_to_float(uint16_t h)
+{
+    const int exponent = (h >> 10) & 0x1f, mantissa = h & 0x3ff;
+    float magnitude = (exponent == 0) ? ldexp(static_cast<float>(mantissa), -24)
+                      : (exponent == 31) ? (mantissa ? NAN : INFINITY)
+                                         : ldexp(static_cast<float>(mantissa | 0x400), exponent - 25);
+    return (h & 0x8000) ? -magnitude : magnitude;
+}
+
+// A 1000 x 750 BGR frame letterboxed to 640 x 640 against a float bilinear resize of the same
+// frame (centre-aligned like cv::resize), plus the recorded transform.
+static bool verify_letterbox()
+{
+    const int src_w = 1000, src_h = 750, dst = 640;
+    const size_t stride = src_w * 3 + 16;
+    mt19937 rng(9);
+    uniform_int_distribution<int> byte(0, 255);
+    vector<uint8_t> bgr(stride * src_h);
+    for (uint8_t &v : bgr)
+        v = static_cast<uint8_t>(byte(rng));
+
+    LetterboxPreprocessor letterbox(dst, dst);
+    vector<uint8_t> out(letterbox.frame_size());
+    const int repeats = 50;
+    LetterboxTransform transform;
+    auto start = chrono::steady_clock::now();
+    for (int r = 0; r < repeats; r++)
+        transform = letterbox.run(bgr.data(), src_w, src_h, stride, out.data());
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / repeats;
+
+    const float scale = 0.64f;
+    const int content_h = 480, pad_top = (dst - content_h) / 2;
+    int max_diff = 0;
+    for (int y = 0; y < dst; y++)
+    {
+        for (int x = 0; x < dst; x++)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                float expected = 114.0f;
+                const int cy = y - pad_top;
+                if (cy >= 0 && cy < content_h)
+                {
+                    float sx = min(max((x + 0.5f) / scale - 0.5f, 0.0f), src_w - 1.0f);
+                    float sy = min(max((cy + 0.5f) / scale - 0.5f, 0.0f), src_h - 1.0f);
+                    int x0 = static_cast<int>(sx), y0 = static_cast<int>(sy);
+                    int x1 = min(x0 + 1, src_w - 1), y1 = min(y0 + 1, src_h - 1);
+                    float fx = sx - x0, fy = sy - y0;
+                    auto at = [&](int px, int py) { return static_cast<float>(bgr[py * stride + 3 * px + (2 - c)]); };
+                    expected = (at(x0, y0) * (1 - fx) + at(x1, y0) * fx) * (1 - fy) + (at(x0, y1) * (1 - fx) + at(x1, y1) * fx) * fy;
+                }
+                max_diff = max(max_diff, abs(static_cast<int>(out[(static_cast<size_t>(y) * dst + x) * 3 + c]) -
+                                             static_cast<int>(lround(expected))));
+            }
+        }
+    }
+
+    // A box over the whole source comes back as the whole plain-resized frame.
+    Coco17DetectionResult box(0, 0.0f, static_cast<float>(pad_top), dst, static_cast<float>(content_h), 1.0f);
+    transform.to_resized(dst, dst).apply(box);
+    const bool transform_ok = fabs(box.top_left_x) < 1e-3f && fabs(box.top_left_y) < 1e-3f &&
+                              fabs(box.width - dst) < 1e-3f && fabs(box.height - dst) < 1e-3f;
+    // 7-bit weights: within one level of the float reference.
+
+    // The transform must come back for a copy of the frame (the harness may copy its queries),
+    // and not for a different frame.
+    LetterboxTransformTable table;
+    table.record(out.data(), out.size(), transform);
+    const vector<uint8_t> copy = out;
+    vector<uint8_t> other = out;
+    other[other.size() / 2] ^= 1;
+    const auto start_lookup = chrono::steady_clock::now();
+    const LetterboxTransform found = table.find(copy.data(), copy.size());
+    const double lookup_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start_lookup).count();
+    const bool table_ok = found.scale == transform.scale && found.pad_x == transform.pad_x && found.pad_y == transform.pad_y &&
+                          found.source_w == src_w && table.find(other.data(), other.size()).identity();
+
+    const bool ok = max_diff <= 1 && transform_ok && table_ok;
+    cout << "-I- Letterbox 1000x750 -> 640x640: " << ms << " ms, max abs. error " << max_diff << " levels, transform "
+         << (transform_ok ? "ok" : "wrong") << ", lookup by frame " << (table_ok ? "ok" : "wrong") << " (" << lookup_ms
+         << " ms)" << (ok ? "" : "  <-- FAILED") << endl;
+    return ok;
+}
+
+// A 320 x 240 gradient JPEG tagged with each EXIF orientation, through decode_image against
+// cv::imread (which applies the tag): full size, and scaled to half the upright size against
+// cv::resize of the imread image. A wrong turn or flip of the gradient costs tens of levels.
+static bool verify_exif_orientation()
+{
+#if AI_BMT_MOCK_HAVE_OPENCV
+    cv::Mat image(240, 320, CV_8UC3);
+    for (int y = 0; y < image.rows; y++)
+        for (int x = 0; x < image.cols; x++)
+            image.at<cv::Vec3b>(y, x) = cv::Vec3b(static_cast<uint8_t>(x * 255 / 319), static_cast<uint8_t>(y * 255 / 239), 128);
+    vector<uint8_t> jpeg;
+    cv::imencode(".jpg", image, jpeg, {cv::IMWRITE_JPEG_QUALITY, 95});
+    // The EXIF segment goes behind the JFIF APP0 segment, if any.
+    size_t insert_at = 2;
+    if (jpeg.size() > 6 && 0xFF == jpeg[2] && 0xE0 == jpeg[3])
+        insert_at = 4 + (static_cast<size_t>(jpeg[4]) << 8 | jpeg[5]);
+    const string path = (filesystem::temp_directory_path() / "ai_bmt_exif_orientation.jpg").string();
+
+    bool ok = true;
+    double worst_full = 0.0, worst_scaled = 0.0;
+    for (int orientation = 1; orientation <= 8; orientation++)
+    {
+        // APP1: "Exif\0\0", little-endian TIFF header, IFD0 holding only Orientation (SHORT).
+        const vector<uint8_t> app1 = {0xFF, 0xE1, 0x00, 0x22, 'E', 'x', 'i', 'f', 0, 0,
+                                      'I', 'I', 0x2A, 0, 8, 0, 0, 0,
+                                      1, 0, 0x12, 0x01, 3, 0, 1, 0, 0, 0, static_cast<uint8_t>(orientation), 0, 0, 0,
+                                      0, 0, 0, 0};
+        vector<uint8_t> tagged(jpeg.begin(), jpeg.begin() + insert_at);
+        tagged.insert(tagged.end(), app1.begin(), app1.end());
+        tagged.insert(tagged.end(), jpeg.begin() + insert_at, jpeg.end());
+        const bool parsed = image_decoder_detail::exif_orientation(tagged.data(), tagged.size()) == orientation;
+        {
+            ofstream file(path, ios::binary);
+            file.write(reinterpret_cast<const char *>(tagged.data()), tagged.size());
+        }
+
+        const cv::Mat expected = cv::imread(path, cv::IMREAD_COLOR);
+        const cv::Mat full = decode_image(path);
+        cv::Mat expected_scaled;
+        cv::resize(expected, expected_scaled, cv::Size(expected.cols / 2, expected.rows / 2), 0, 0, cv::INTER_AREA);
+        const cv::Mat scaled = decode_image(path, expected.cols / 2, expected.rows / 2);
+        auto mean_diff = [](const cv::Mat &a, const cv::Mat &b) {
+            return (a.size() == b.size()) ? cv::norm(a, b, cv::NORM_L1) / a.total() / a.channels() : 255.0;
+        };
+        const double full_diff = mean_diff(expected, full), scaled_diff = mean_diff(expected_scaled, scaled);
+        worst_full = max(worst_full, full_diff);
+        worst_scaled = max(worst_scaled, scaled_diff);
+        // Same bitstream at full size; the DCT-domain downscale rounds differently from INTER_AREA.
+        ok = parsed && full_diff < 1.0 && scaled_diff < 4.0 && ok;
+    }
+    filesystem::remove(path);
+    cout << "-I- EXIF orientation 1-8 (" << (AI_BMT_HAVE_TURBOJPEG ? "TurboJPEG" : "cv::imread") << " vs cv::imread): max mean error "
+         << worst_full << " levels full size, " << worst_scaled << " levels scaled" << (ok ? "" : "  <-- FAILED") << endl;
+    return ok;
+#else
+    cout << "-I- EXIF orientation: skipped, built without OpenCV" << endl;
+    return true;
+#endif
+}
+
+// A 224 x 224 BGR frame with padded rows, through the example's old multi-pass preprocessing and
+// through bgr_to_chw / bgr_to_chw_fp16.
+static int verify_preprocess()
+{
+    const int width = 224, height = 224;
+    const size_t stride = width * 3 + 8;
+    mt19937 rng(5);
+    uniform_int_distribution<int> byte(0, 255);
+    vector<uint8_t> bgr(stride * height);
+    for (uint8_t &v : bgr)
+        v = static_cast<uint8_t>(byte(rng));
+    const ChannelNormalization norm = ChannelNormalization::imagenet();
+    const int repeats = 50;
+
+    vector<float> reference;
+    auto start = chrono::steady_clock::now();
+    for (int r = 0; r < repeats; r++)
+    {
+        vector<uint8_t> rgb;
+        for (int y = 0; y < height; y++)
+            for (int x = 0; x < width; x++)
+                for (int c = 2; c >= 0; c--)
+                    rgb.push_back(bgr[y * stride + 3 * x + c]);
+        vector<float> scaled(rgb.size());
+        for (size_t i = 0; i < rgb.size(); i++)
+            scaled[i] = rgb[i] * (1.0f / 255);
+        reference.clear();
+        for (int c = 0; c < 3; c++)
+            for (size_t i = c; i < scaled.size(); i += 3)
+                reference.emplace_back((scaled[i] - norm.mean[c]) / norm.std[c]);
+    }
+    double multi_pass_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / repeats;
+
+    vector<float> fused(reference.size());
+    start = chrono::steady_clock::now();
+    for (int r = 0; r < repeats; r++)
+        bgr_to_chw(bgr.data(), width, height, stride, norm, fused.data());
+    double fused_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / repeats;
+
+    vector<uint16_t> half(reference.size());
+    start = chrono::steady_clock::now();
+    for (int r = 0; r < repeats; r++)
+        bgr_to_chw_fp16(bgr.data(), width, height, stride, norm, half.data());
+    double half_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / repeats;
+
+    double max_abs = 0.0, max_half_rel = 0.0;
+    for (size_t i = 0; i < reference.size(); i++)
+    {
+        max_abs = max(max_abs, fabs(static_cast<double>(fused[i]) - reference[i]));
+        max_half_rel = max(max_half_rel, fabs(static_cast<double>(half_to_float(half[i])) - reference[i]) / max(1e-3, fabs(static_cast<double>(reference[i]))));
+    }
+    // Folding the normalization into one multiply-add changes the float rounding by a few ulp; fp16
+    // keeps 11 significant bits.
+    bool ok = max_abs < 1e-5 && max_half_rel < 1e-3;
+    cout << "-I- Preprocess 224x224: multi-pass " << multi_pass_ms << " ms, fused float " << fused_ms << " ms (max abs. error "
+         << max_abs << "), fused fp16 " << half_ms << " ms (max rel. error " << max_half_rel << ")" << (ok ? "" : "  <-- FAILED") << endl;
+    ok = verify_letterbox() && ok;
+    ok = verify_exif_orientation() && ok;
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if (string(argv[i]) == "-verify_decode")
+            return verify_yolov5_decode();
+        if (string(argv[i]) == "-verify_preprocess")
+            return verify_preprocess();
+    }
+
+    const string model = getCmdOption(argc, argv, "-model=", "classification");
+    const size_t frames = stoul(getCmdOption(argc, argv, "-frames=", "1000"));
+    const size_t device_count = max<size_t>(stoul(getCmdOption(argc, argv, "-devices=", "1")), 1);
+    const bool fused_postprocess = getCmdOption(argc, argv, "-postprocess=", "full") == "fused";
+    const size_t decode_threads = stoul(getCmdOption(argc, argv, "-decode_threads=", model == "yolov5" ? "3" : "0"));
+
+    MockBackendConfig config = (model == "yolov5") ? MockBackendConfig::yolov5_640() : MockBackendConfig::classification_1000();
+    config.engine_count = stoul(getCmdOption(argc, argv, "-engines=", "1"));
+    config.device_queue_size = stoul(getCmdOption(argc, argv, "-queue=", "4"));
+    config.service_time = chrono::microseconds(stol(getCmdOption(argc, argv, "-service_us=", "1000")));
+    config.jitter = parse_jitter(getCmdOption(argc, argv, "-jitter=", "none"));
+    config.jitter_amount = chrono::microseconds(stol(getCmdOption(argc, argv, "-jitter_us=", "0")));
+
+    // The queries only need to exist; the mock never reads them.
+    vector<VariantType> data(frames, vector<uint8_t>(config.input_frame_size));
+
+    vector<shared_ptr<MockBackend>> devices;
+    vector<shared_ptr<InferenceBackend>> backends;
+    for (size_t i = 0; i < device_count; i++)
+    {
+        config.seed += i;
+        devices.push_back(make_shared<MockBackend>(config));
+        backends.push_back(devices.back());
+    }
+    AsyncPipeline pipeline(combine_backends(backends), decode_threads);
+
+    AsyncPipeline::DecodeFn decode;
+    if (model == "yolov5")
+    {
+        WorkerPool *pool = pipeline.decode_pool();
+        decode = [pool, fused_postprocess](const InferenceCompletion &completion, BMTResult &result)
+        {
+            if (fused_postprocess)
+            {
+                static thread_local vector<Coco17DetectionResult> detections;
+                DetectionOptions options;
+                options.apply_sigmoid = false; // the mock produces sigmoid outputs like the Hailo HEF
+                detect_yolov5(yolov5_heads(completion.outputs), options, detections);
+                write_detections_as_yolov5_rows(detections, 25200, result.objectDetectionResult);
+            }
+            else if (pool)
+                decode_yolov5_parallel(yolov5_heads(completion.outputs), false, result.objectDetectionResult, *pool);
+            else
+                decode_yolov5(yolov5_heads(completion.outputs), false, result.objectDetectionResult);
+        };
+    }
+    else
+    {
+        decode = [](const InferenceCompletion &completion, BMTResult &result)
+        {
+            const float *scores = reinterpret_cast<const float *>(completion.outputs[0].data);
+            result.classProbabilities.assign(scores, scores + 1000);
+        };
+    }
+
+    vector<BMTResult> results;
+    PipelineStats stats = pipeline.run(data, results, decode);
+    auto wall = chrono::duration_cast<chrono::nanoseconds>(chrono::duration<double>(stats.seconds));
+
+    cout << "-I-----------------------------------------------" << endl;
+    cout << "-I- " << config.name << endl;
+    cout << "-I- Devices: " << device_count << ", engines: " << config.engine_count << ", queue: " << config.device_queue_size
+         << ", service: " << config.service_time.count() << " us, decode threads: " << decode_threads << endl;
+    cout << "-I-----------------------------------------------" << endl;
+    cout << "-I- Frames:         " << stats.frames << " (" << stats.failed_frames << " failed)" << endl;
+    cout << "-I- Total time:     " << stats.seconds << " sec" << endl;
+    cout << "-I- Average FPS:    " << stats.fps() << endl;
+    cout << "-I- Ideal FPS:      " << 1e6 * device_count * config.engine_count / config.service_time.count() << endl;
+    for (size_t i = 0; i < devices.size(); i++)
+    {
+        MockDeviceStats device = devices[i]->stats();
+        cout << "-I- Device " << i << " util.: " << 100.0 * device.utilization(wall) << " % (" << device.frames << " frames)" << endl;
+    }
+    cout << "-I-----------------------------------------------" << endl;
+    return stats.failed_frames == 0 ? 0 : 1;
+}
@@ -10,6 +10,12 @@
 #include <onnxruntime_cxx_api.h>
 #include <opencv2/opencv.hpp>
 #include <filesystem>
+#include <numeric>
+#include "utils/detection_decoders.hpp"
+#include "utils/image_decoder.hpp"
+#include "utils/ort_execution_provider.hpp"
+#include "utils/ort_model_cache.hpp"
+#include "utils/ort_session_pool.hpp"
 
 using namespace std;
 using namespace cv;
@@ -24,35 +30,83 @@ using namespace Ort;
 // If you use unmanaged data types such as dynamic arrays (e.g., int* data = new int[...]), you must ensure that they are properly deleted at the end of runInference() definition.
 using BMTDataType = vector<float>;
 
+// Queries per session->Run. 0: picked in Initialize by timing batches up to ORT_MAX_BATCH.
+constexpr size_t ORT_BATCH_SIZE = 0;
+constexpr size_t ORT_MAX_BATCH = 8;
+
+// ORT sessions as "threads@cpus;..." (see parse_session_topology), e.g. "4@4-7;4@0-3" for one
+// pinned session per RK3588 cluster. Empty: one session with ORT's default thread count.
+constexpr const char *ORT_SESSION_TOPOLOGY = "";
+
+// Execution providers in order of preference (see parse_provider_list). Providers not built into
+// the ORT library are skipped, one that fails to build the session falls back to the next, and
+// the CPU provider is always last. The chosen one and ORT's node placement are printed at startup.
+constexpr const char *ORT_EXECUTION_PROVIDERS = "xnnpack,acl,armnn,cpu";
+
+// Save the optimized graph next to the model (<model>.<key>.ort, see OrtModelCache) and load it on
+// later launches instead of optimizing the model again.
+constexpr bool ORT_MODEL_CACHE = true;
+
 // To view detailed information on what and how to implement for "AI_BMT_Interface," navigate to its definition (e.g., in Visual Studio/VSCode: Press F12).
 class OnjectDetection_Interface_Implementation : public AI_BMT_Interface
 {
 private:
-    Env env;
-    RunOptions runOptions;
-    shared_ptr<Session> session;
-    array<const char *, 1> inputNames;
-    array<const char *, 1> outputNames;
-    MemoryInfo memory_info = Ort::MemoryInfo::CreateCpu(OrtDeviceAllocator, OrtMemTypeCPU);
+    OrtPlacementLog placement_log; // before env, which logs into it
+    Env env{ORT_LOGGING_LEVEL_WARNING, "AI_BMT", OrtPlacementLog::log, &placement_log};
+    unique_ptr<OrtSessionPool> sessions;
+    unique_ptr<DetectionDecoder> decoder; // picked from the output shape, see Initialize
+    DetectionOptions detection_options;
+    bool harness_rows = false; // the output already is the harness's {rows, 85} tensor
+    size_t result_rows = 0;
+    int input_w = 640;
+    int input_h = 640;
 
 public:
+    ~OnjectDetection_Interface_Implementation()
+    {
+        if (sessions)
+            sessions->report(cout);
+    }
+
     virtual void Initialize(string modelPath) override
     {
         // session initializer
         SessionOptions sessionOptions;
         sessionOptions.SetExecutionMode(ExecutionMode::ORT_SEQUENTIAL);
-        sessionOptions.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_EXTENDED);
-        wstring modelPathwstr(modelPath.begin(), modelPath.end());
-        session = make_shared<Session>(env, modelPathwstr.c_str(), sessionOptions);
-
-        // Get input and output names
-        AllocatorWithDefaultOptions allocator;
-        AllocatedStringPtr inputName = session->GetInputNameAllocated(0, allocator);
-        AllocatedStringPtr outputName = session->GetOutputNameAllocated(0, allocator);
-        inputNames = {inputName.get()};
-        outputNames = {outputName.get()};
-        inputName.release();
-        outputName.release();
+        // ORT_ENABLE_EXTENDED is applied by the cache, which skips it for an already optimized model.
+        OrtModelCache modelCache(env, modelPath, GraphOptimizationLevel::ORT_ENABLE_EXTENDED, ORT_MODEL_CACHE);
+        sessions = make_unique<OrtSessionPool>(parse_session_topology(ORT_SESSION_TOPOLOGY), sessionOptions,
+                                               provider_session_factory(parse_provider_list(ORT_EXECUTION_PROVIDERS),
+                                                                        [&modelCache](const SessionOptions &options, OrtProvider provider)
+                                                                        { return modelCache.create(options, provider_name(provider)); },
+                                                                        &placement_log));
+
+        // {N, 3, H, W}; a dynamic size keeps 640x640.
+        vector<int64_t> inputShape = sessions->session()->GetInputTypeInfo(0).GetTensorTypeAndShapeInfo().GetShape();
+        if (inputShape.size() == 4 && inputShape[2] > 0 && inputShape[3] > 0)
+        {
+            input_h = static_cast<int>(inputShape[2]);
+            input_w = static_cast<int>(inputShape[3]);
+        }
+        result_rows = yolov5_row_count(input_h, input_w);
+
+        // YOLOv5 {1,25200,85}, YOLOv5u/v8/v9/11/12 {1,84,8400} or YOLOv10 {1,300,6}: taken from the model
+        // instead of editing the shape by hand. The factory throws for a layout it doesn't know.
+        vector<int64_t> outputShape = sessions->session()->GetOutputTypeInfo(0).GetTensorTypeAndShapeInfo().GetShape();
+        outputShape[0] = 1; // dynamic batch
+        decoder = create_detection_decoder({outputShape}, input_h, input_w);
+        // The harness reads YOLOv5 rows: a YOLOv5 output goes to it as is, any other head is decoded
+        // here and its detections written as rows (see write_detections_as_yolov5_rows).
+        harness_rows = outputShape.size() == 3 && outputShape[1] == static_cast<int64_t>(result_rows) &&
+                       outputShape[2] == YOLOV5_ATTRIBUTES;
+        cout << "-I- Input " << input_w << "x" << input_h << ", detection head: " << decoder->name()
+             << (harness_rows ? "" : ", decoded to YOLOv5 rows") << endl;
+
+        // Batches need a dynamic batch dimension ({-1, 3, 640, 640}); a fixed one runs with batch 1.
+        if (ORT_BATCH_SIZE > 0)
+            sessions->set_batch_size(ORT_BATCH_SIZE);
+        else
+            sessions->tune(ORT_MAX_BATCH);
     }
 
     virtual Optional_Data getOptionalData() override
@@ -74,12 +128,7 @@ public:
     virtual VariantType convertToPreprocessedDataForInference(const string &imagePath) override
     {
         // Load padded image
-        Mat image = imread(imagePath);
-        if (image.empty())
-        {
-            cerr << "Image not found at: " << imagePath << endl;
-            throw runtime_error("Image not found!");
-        }
+        Mat image = decode_image(imagePath, input_w, input_h); // throws if the image can't be read
 
         // Convert to float and normalize
         Mat floatImg;
@@ -102,39 +151,20 @@ public:
     {
         cout << "runInference" << endl;
 
-        // onnx option setting
-        const int querySize = data.size();
-        vector<BMTResult> results;
-        array<int64_t, 4> inputShape = {1, 3, 640, 640};
-
-        // array<int64_t, 3> outputShape = { 1, 25200, 85 }; //Yolov5
-        // array<int64_t, 3> outputShape = { 1, 84, 8400 }; //Yolov5u, Yolov8, Yolov9, Yolo11, Yolo12
-        array<int64_t, 3> outputShape = {1, 300, 6}; // Yolov10
-
-        for (int i = 0; i < querySize; i++)
-        {
-            BMTDataType imageVec;
-            try
-            {
-                imageVec = get<BMTDataType>(data[i]);
-            }
-            catch (const std::bad_variant_access &e)
-            {
-                string errorMessage = "Error: bad_variant_access at index " + to_string(i) + ": " + e.what();
-                throw runtime_error(errorMessage.c_str());
-            }
-            vector<float> outputData(outputShape[1] * outputShape[2]);
-            auto inputTensor = Ort::Value::CreateTensor<float>(memory_info, imageVec.data(), imageVec.size(), inputShape.data(), inputShape.size());
-            auto outputTensor = Value::CreateTensor<float>(memory_info, outputData.data(), outputData.size(), outputShape.data(), outputShape.size());
-
-            // Run inference
-            session->Run(runOptions, inputNames.data(), &inputTensor, 1, outputNames.data(), &outputTensor, 1);
-
-            // Update results
-            BMTResult result;
-            result.objectDetectionResult = outputData;
-            results.push_back(result);
-        }
+        // {N, 3, H, W} per Run, each query's slice of the output scattered back to it.
+        vector<BMTResult> results(data.size());
+        sessions->run(data, [this, &results](size_t i, const float *output, size_t count)
+                    {
+                        if (harness_rows)
+                        {
+                            results[i].objectDetectionResult.assign(output, output + count);
+                            return;
+                        }
+                        // Threshold (multi-label), NMS and the 300-box cap run here, before the
+                        // harness's own, see DetectionOptions.
+                        static thread_local vector<Coco17DetectionResult> detections;
+                        decoder->detect({output}, detection_options, detections);
+                        write_detections_as_yolov5_rows(detections, result_rows, results[i].objectDetectionResult); });
         return results;
     }
 };
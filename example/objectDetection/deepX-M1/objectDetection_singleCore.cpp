@@ -3,14 +3,22 @@
 #include <filesystem>
 #include <opencv2/opencv.hpp>
 #include "dxrt/dxrt_api.h"
+#include "utils/async_pipeline.hpp"
+#include "utils/dxrt_backend.hpp"
+#include "utils/image_decoder.hpp"
+#include "utils/tensor_packer.hpp"
+#include "utils/yolo_decode.hpp"
 using namespace std;
 using namespace cv;
 
 class ObjectDetection_Implementation_SingleCore : public AI_BMT_Interface
 {
     shared_ptr<dxrt::InferenceEngine> ie;
-    int align_factor;
-    int input_w = 640, input_h = 640, input_c = 3;
+    unique_ptr<AsyncPipeline> pipeline;
+    int input_w = 640, input_h = 640;
+    TensorPackLayout input_layout = TensorPackLayout::dxnn(input_w, input_h);
+    const int maxConcurrentRequests = 1; // Sync: one frame on the NPU at a time
+    const size_t decodeThreads = 3;      // with the DX-RT waiter thread, one per A76 core
 
 public:
     virtual Optional_Data getOptionalData() override
@@ -26,103 +34,56 @@ public:
     {
         cout << "Initialze() is called" << endl;
         ie = make_shared<dxrt::InferenceEngine>(modelPath);
-        align_factor = ((int)(input_w * input_c)) & (-64);
-        align_factor = (input_w * input_c) - align_factor;
+        pipeline = make_unique<AsyncPipeline>(make_shared<DxrtBackend>(ie, input_layout.frame_size(), maxConcurrentRequests), decodeThreads);
     }
 
     virtual VariantType convertToPreprocessedDataForInference(const string &imagePath) override
     {
         cv::Mat input;
-        input = cv::imread(imagePath, cv::IMREAD_COLOR);
-        cv::cvtColor(input, input, cv::COLOR_BGR2RGB);
-        return std::vector<uint8_t>(input.data, input.data + input.total() * input.elemSize());
-    }
-
-    inline float sigmoid(float x)
-    {
-        return 1.0f / (1.0f + exp(-x));
+        decode_image(imagePath, input_w, input_h, input);
+        return pack_tensor(input, input_layout);
     }
 
     // Example Code for (YoloV5n/s/m)
     virtual vector<BMTResult> runInference(const vector<VariantType> &data) override
     {
+        // The pipeline binds each query's buffer in place and decodes on its decode threads, which
+        // also share each frame's decode.
         vector<BMTResult> queryResult;
-        const int querySize = data.size();
-
-        // YOLOv5n Anchor definitions (standard)
-        vector<vector<pair<float, float>>> anchors = {
-            {{10, 13}, {16, 30}, {33, 23}},     // P3: 80x80
-            {{30, 61}, {62, 45}, {59, 119}},    // P4: 40x40
-            {{116, 90}, {156, 198}, {373, 326}} // P5: 20x20
-        };
-
-        vector<int> strides = {8, 16, 32};
-
-        for (int i = 0; i < querySize; i++)
-        {
-            vector<uint8_t> inputBuf = get<vector<uint8_t>>(data[i]);
-            vector<shared_ptr<dxrt::Tensor>> outputs = ie->Run(inputBuf.data());
-
-            BMTResult result;
-            vector<float *> feature_maps;
-            for (int i = 0; i < outputs.size(); i++)
-                feature_maps.push_back((float *)outputs[i]->data());
-
-            vector<float> output;
-            output.reserve(25200 * 85); // 2142000
-            for (int i = 0; i < outputs.size(); ++i)
+        WorkerPool *pool = pipeline->decode_pool();
+        pipeline->run(data, queryResult, [pool](const InferenceCompletion &completion, BMTResult &result)
+                      {
+            // YOLOv5n Anchor definitions (standard)
+            static const float anchors[3][3][2] = {
+                {{10, 13}, {16, 30}, {33, 23}},     // P3: 80x80
+                {{30, 61}, {62, 45}, {59, 119}},    // P4: 40x40
+                {{116, 90}, {156, 198}, {373, 326}} // P5: 20x20
+            };
+            static const int strides[3] = {8, 16, 32};
+
+            static thread_local vector<YoloV5Head> heads;
+            heads.resize(completion.outputs.size());
+            for (size_t i = 0; i < completion.outputs.size() && i < 3; ++i)
             {
-                auto out = outputs[i];
-                auto shape = out->shape(); // [1, H, W, 256]
-                float *data = (float *)out->data();
-
-                int H = shape[1];
-                int W = shape[2];
-                int C = shape[3]; // 256
-
-                const auto &anchorSet = anchors[i];
-                int stride = strides[i];
-
-                for (int y = 0; y < H; ++y)
+                const TensorView &output = completion.outputs[i]; // [1, H, W, 256]
+                YoloV5Head &head = heads[i];
+                head.data = output.data;
+                head.grid_h = static_cast<int>(output.shape.dims[1]);
+                head.grid_w = static_cast<int>(output.shape.dims[2]);
+                head.cell_stride = static_cast<int>(output.shape.dims[3]); // 256
+                head.stride = strides[i];
+                for (int a = 0; a < 3; ++a)
                 {
-                    for (int x = 0; x < W; ++x)
-                    {
-                        for (int a = 0; a < 3; ++a)
-                        {
-                            float raw[85];
-                            int offset = ((y * W + x) * C) + (a * 85);
-                            memcpy(raw, data + offset, sizeof(float) * 85);
-
-                            // anchor
-                            float pw = anchorSet[a].first;
-                            float ph = anchorSet[a].second;
-
-                            // center
-                            raw[0] = (sigmoid(raw[0]) * 2.0f - 0.5f + x) * stride;
-                            raw[1] = (sigmoid(raw[1]) * 2.0f - 0.5f + y) * stride;
-
-                            // size
-                            raw[2] = pow(sigmoid(raw[2]) * 2.0f, 2.0f) * pw;
-                            raw[3] = pow(sigmoid(raw[3]) * 2.0f, 2.0f) * ph;
-
-                            // confidence
-                            raw[4] = sigmoid(raw[4]);
-
-                            // class probs
-                            for (int c = 5; c < 85; ++c)
-                                raw[c] = sigmoid(raw[c]);
-
-                            // confidence threshold나 NMS는 나중에 사용
-                            output.insert(output.end(), raw, raw + 85);
-                        }
-                    }
+                    head.anchors[a][0] = anchors[i][a][0];
+                    head.anchors[a][1] = anchors[i][a][1];
                 }
             }
-            // cout << "output size: " << output.size() << " (expect 25200 × 85 = 2142000)" << endl;
-            result.objectDetectionResult = output;
-            queryResult.push_back(result);
-        }
-
+            // sigmoid on every channel, box decode, written as 25200 x 85 (confidence threshold나 NMS는 나중에 사용).
+            // Scores only feed the threshold and NMS, so the polynomial sigmoid (abs. error < 2.2e-5) is plenty.
+            if (pool)
+                decode_yolov5_parallel(heads, true, result.objectDetectionResult, *pool, SigmoidApprox::POLY);
+            else
+                decode_yolov5(heads, true, result.objectDetectionResult, SigmoidApprox::POLY); });
         return queryResult;
     }
 };
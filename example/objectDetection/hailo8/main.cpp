@@ -1,228 +1,244 @@
-#include "hailo/hailort.hpp"
-#include "ai_bmt_interface.h"
-#include "ai_bmt_gui_caller.h"
-#include <opencv2/opencv.hpp>
-#include <opencv2/highgui.hpp>
-#include <iostream>
-#include <vector>
-#include <filesystem>
-#include <memory>
-#include <string>
-#include <algorithm>
-#include <thread>
-#include <variant>
-#include <stdexcept>
-#include <mutex>
-#include <future>
-#include "utils/async_inference.hpp"
-#include "utils/utils.hpp"
-using namespace hailort;
-using namespace std;
-#if defined(__unix__)
-#include <sys/mman.h>
-#endif
-
-constexpr int WIDTH = 640;
-constexpr int HEIGHT = 640;
-
-using BMTDataType = vector<float>;
-
-using namespace std;
-
-hailo_status run_preprocess(std::shared_ptr<BoundedTSQueue<PreprocessedFrameItem>> preprocessed_queue, const vector<VariantType> &data, size_t start, size_t end)
-{
-    for (int i = start; i < end; i++)
-    {
-        vector<uint8_t> inputBuf = get<vector<uint8_t>>(data[i]);
-        auto preprocessed_frame_item = create_preprocessed_frame_item(inputBuf, WIDTH, HEIGHT, i);
-        preprocessed_queue->push(preprocessed_frame_item);
-    }
-    preprocessed_queue->stop();
-    return HAILO_SUCCESS;
-}
-
-hailo_status run_inference_async(std::shared_ptr<BoundedTSQueue<PreprocessedFrameItem>> preprocessed_queue, shared_ptr<AsyncModelInfer> model)
-{
-    while (true)
-    {
-        PreprocessedFrameItem item;
-        if (!preprocessed_queue->pop(item))
-            break;
-        model->infer(std::make_shared<vector<uint8_t>>(item.resized_for_infer), item.frame_idx);
-    }
-    return HAILO_SUCCESS;
-}
-
-hailo_status run_post_process(std::shared_ptr<BoundedTSQueue<InferenceOutputItem>> results_queue, vector<BMTResult> &batchResult, size_t bs)
-{
-    // YOLOv5n Anchor definitions (standard)
-    vector<vector<pair<float, float>>> anchors = {
-        {{10, 13}, {16, 30}, {33, 23}},     // P3: 80x80
-        {{30, 61}, {62, 45}, {59, 119}},    // P4: 40x40
-        {{116, 90}, {156, 198}, {373, 326}} // P5: 20x20
-    };
-
-    vector<int> strides = {8, 16, 32};
-
-    size_t i = 0;
-    while (true)
-    {
-        InferenceOutputItem output_item;
-        if (!results_queue->pop(output_item))
-            break;
-
-        auto frame_idx = output_item.frame_idx;
-        vector<float> output;
-        output.reserve(25200 * 85); // 2142000
-
-        for (size_t tensor_index = 0; tensor_index < output_item.output_data_and_infos.size(); ++tensor_index)
-        {
-            float *data = reinterpret_cast<float *>(output_item.output_data_and_infos[tensor_index].first);
-            auto &anchorSet = anchors[tensor_index];
-            int stride = strides[tensor_index];
-
-            int H = 80 >> tensor_index; // 80, 40, 20
-            int W = 80 >> tensor_index;
-            int C = 85 * 3;
-
-            for (int y = 0; y < H; ++y)
-            {
-                for (int x = 0; x < W; ++x)
-                {
-                    for (int a = 0; a < 3; ++a)
-                    {
-                        float raw[85];
-                        int offset = ((y * W + x) * C) + (a * 85);
-                        memcpy(raw, data + offset, sizeof(float) * 85);
-
-                        // anchor
-                        float pw = anchorSet[a].first;
-                        float ph = anchorSet[a].second;
-
-                        // center
-                        raw[0] = (raw[0] * 2.0f - 0.5f + x) * stride;
-                        raw[1] = (raw[1] * 2.0f - 0.5f + y) * stride;
-
-                        // size
-                        raw[2] = pow(raw[2] * 2.0f, 2.0f) * pw;
-                        raw[3] = pow(raw[3] * 2.0f, 2.0f) * ph;
-
-                        output.insert(output.end(), raw, raw + 85);
-                    }
-                }
-            }
-        }
-
-        BMTResult result;
-        result.objectDetectionResult = output;
-        batchResult[frame_idx] = result;
-        if ((++i) == bs)
-            results_queue->stop();
-    }
-    return HAILO_SUCCESS;
-}
-
-class Virtual_Submitter_Implementation : public AI_BMT_Interface
-{
-    const size_t MAX_QUEUE_SIZE = 80; // must bigger than or equal to residual set(80)
-    std::shared_ptr<BoundedTSQueue<PreprocessedFrameItem>> preprocessed_queue;
-    std::shared_ptr<BoundedTSQueue<InferenceOutputItem>> results_queue;
-    shared_ptr<AsyncModelInfer> model;
-
-public:
-    Virtual_Submitter_Implementation()
-    {
-    }
-
-    virtual Optional_Data getOptionalData() override
-    {
-        Optional_Data data;
-        data.cpu_type = "Broadcom BCM2712 quad-core Arm Cortex A76 processor @ 2.4GHz"; // e.g., Intel i7-9750HF
-        data.accelerator_type = "Hailo-8";                                              // e.g., DeepX M1(NPU)
-        data.submitter = "Hailo";                                                       // e.g., DeepX
-        data.cpu_core_count = "4";                                                      // e.g., 16
-        data.cpu_ram_capacity = "8GB";                                                  // e.g., 32GB
-        data.cooling = "Air";                                                           // e.g., Air, Liquid, Passive
-        data.cooling_option = "Active";                                                 // e.g., Active, Passive (Active = with fan/pump, Passive = without fan)
-        data.cpu_accelerator_interconnect_interface = "PCIe 3.0 4-lane";                // e.g., PCIe Gen5 x16
-        data.benchmark_model = "YoloV5";                                                // e.g., ResNet-50
-        data.operating_system = "Ubuntu 24.04.2 LTS";                                   // e.g., Ubuntu 20.04.5 LTS
-        return data;
-    }
-
-    virtual void Initialize(string modelPath) override
-    {
-        model = make_shared<AsyncModelInfer>();
-        model->crt();
-        model->PathAndResult(modelPath);
-        preprocessed_queue = std::make_shared<BoundedTSQueue<PreprocessedFrameItem>>(MAX_QUEUE_SIZE);
-        results_queue = std::make_shared<BoundedTSQueue<InferenceOutputItem>>(MAX_QUEUE_SIZE);
-        model->configure(results_queue);
-    }
-
-    virtual VariantType convertToPreprocessedDataForInference(const string &imagePath) override
-    {
-        cv::Mat img = cv::imread(imagePath, cv::IMREAD_COLOR);
-        cv::cvtColor(img, img, cv::COLOR_BGR2RGB);
-        vector<uint8_t> inputBuf(HEIGHT * WIDTH * 3);
-        std::memcpy(inputBuf.data(), img.data, HEIGHT * WIDTH * 3);
-        return inputBuf;
-    }
-
-    virtual vector<BMTResult> runInference(const vector<VariantType> &data) override
-    {
-        size_t frame_count = data.size();
-        vector<BMTResult> batchResult(frame_count);
-        for (size_t i = 0; i < frame_count; i += MAX_QUEUE_SIZE)
-        {
-            size_t currentBatchSize = min(MAX_QUEUE_SIZE, frame_count - i);
-            size_t start = i;
-            size_t end = i + currentBatchSize;
-            auto preprocess_thread = std::async(run_preprocess,
-                                                preprocessed_queue,
-                                                std::ref(data),
-                                                start,
-                                                end);
-            auto inference_thread = std::async(run_inference_async,
-                                               preprocessed_queue,
-                                               model);
-            auto output_parser_thread = std::async(run_post_process,
-                                                   results_queue,
-                                                   std::ref(batchResult),
-                                                   currentBatchSize);
-            hailo_status status = wait_and_check_threads(
-                preprocess_thread, "Preprocess",
-                inference_thread, "Inference",
-                output_parser_thread, "Postprocess ");
-
-            if (status != HAILO_SUCCESS)
-            {
-                throw std::runtime_error("Inference failed");
-            }
-        }
-        preprocessed_queue->reset();
-        results_queue->reset();
-        model->clear();
-        return batchResult;
-    }
-};
-
-int main(int argc, char *argv[])
-{
-    filesystem::path exePath = filesystem::absolute(argv[0]).parent_path(); // Get the current executable file path
-    filesystem::path model_path = exePath / "Model" / "ObjectDetection" / "yolov5n_opset12_normalized_quantized.hef";
-    string modelPath = model_path.string();
-    try
-    {
-        // sample_latency_average: 46.3471 ms (without post processing)
-        // sample_latency_average: 64.8433 ms (with post processing)
-
-        shared_ptr<AI_BMT_Interface> interface = make_shared<Virtual_Submitter_Implementation>();
-        AI_BMT_GUI_CALLER caller(interface, modelPath);
-        return caller.call_BMT_GUI(argc, argv);
-    }
-    catch (const exception &ex)
-    {
-        cout << ex.what() << endl;
-    }
-}
+#include "hailo/hailort.hpp"
+#include "ai_bmt_interface.h"
+#include "ai_bmt_gui_caller.h"
+#include <opencv2/opencv.hpp>
+#include <opencv2/highgui.hpp>
+#include <iostream>
+#include <vector>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <algorithm>
+#include <thread>
+#include <variant>
+#include <stdexcept>
+#include <mutex>
+#include <future>
+#include "utils/async_inference.hpp"
+#include "utils/async_pipeline.hpp"
+#include "utils/hailo_backend.hpp"
+#include "utils/image_decoder.hpp"
+#include "utils/letterbox.hpp"
+#include "utils/multi_device_backend.hpp"
+#include "utils/utils.hpp"
+#include "utils/yolo_decode.hpp"
+#include "utils/yolo_postprocess.hpp"
+using namespace hailort;
+using namespace std;
+#if defined(__unix__)
+#include <sys/mman.h>
+#endif
+
+using BMTDataType = vector<float>;
+
+using namespace std;
+
+// Decode runs on 3 pipeline threads so the 4th A76 core stays free for submission and HailoRT.
+constexpr size_t DECODE_THREADS = 3;
+
+// Keep the HEF's native uint8/uint16 outputs: a quarter of the float bytes per frame over PCIe,
+// dequantized inside the decode kernels with each output's vstream quant info.
+constexpr bool NATIVE_OUTPUT_FORMAT = true;
+
+// Opt-in: threshold + NMS here and hand the harness only the surviving boxes (as 25200 x 85 rows
+// that are zero except for one row per detection) instead of decoding every candidate. Uses
+// DetectionOptions' defaults: the harness's 0.001 threshold, every class above it per anchor. The
+// class-aware NMS (IoU 0.45) and the 300-box cap still run before the harness's own, so mAP can
+// differ slightly from handing over every candidate.
+constexpr bool FUSED_POSTPROCESS = false;
+
+// Head geometry from the HEF's output vstream infos and input shape, so a 320/416 build of the
+// model needs no code change. All devices run the same HEF, so the first backend speaks for all.
+YoloV5LayoutPlan plan_hailo_yolov5_layout(AsyncModelInfer &model)
+{
+    vector<YoloV5HeadShape> shapes;
+    for (const auto &info : model.get_output_vstream_infos())
+    {
+        YoloV5HeadShape shape;
+        shape.grid_h = static_cast<int>(info.shape.height);
+        shape.grid_w = static_cast<int>(info.shape.width);
+        shape.channels = static_cast<int>(info.shape.features);
+        // The buffer type is what the output was configured to, not necessarily the HEF's.
+        const hailo_format_type_t type = model.get_infer_model()->output(info.name).expect("Failed to get output stream").format().type;
+        switch (type)
+        {
+        case HAILO_FORMAT_TYPE_UINT8:
+            shape.format = YoloV5HeadFormat::UINT8;
+            break;
+        case HAILO_FORMAT_TYPE_UINT16:
+            shape.format = YoloV5HeadFormat::UINT16;
+            break;
+        case HAILO_FORMAT_TYPE_FLOAT32:
+            shape.format = YoloV5HeadFormat::FLOAT32;
+            break;
+        default: // including an AUTO the configure step left unresolved
+            throw runtime_error("Output " + string(info.name) + " has unsupported format type " + to_string(static_cast<int>(type)));
+        }
+        shape.scale = info.quant_info.qp_scale;
+        shape.zero_point = info.quant_info.qp_zp;
+        shapes.push_back(shape);
+    }
+    hailo_3d_image_shape_t input = model.get_input_shape();
+    return plan_yolov5_layout(shapes, static_cast<int>(input.height), static_cast<int>(input.width));
+}
+
+// pool: split the frame into row bands over these threads too (SingleStream has one frame in
+// flight, so the other decode threads would idle otherwise). boxes undoes the frame's letterbox
+// inside the decode kernels.
+void decode_yolov5_frame(const YoloV5LayoutPlan &layout, const InferenceCompletion &completion, BMTResult &result,
+                         const BoxMapping &boxes, WorkerPool *pool)
+{
+    static thread_local vector<YoloV5Head> heads;
+    layout.bind(heads, [&completion](size_t i) { return completion.outputs[i].data; });
+    for (auto &head : heads)
+        head.map_boxes(boxes.scale_x, boxes.scale_y, boxes.offset_x, boxes.offset_y);
+
+    if (FUSED_POSTPROCESS)
+    {
+        static thread_local vector<Coco17DetectionResult> detections;
+        DetectionOptions options;
+        options.apply_sigmoid = false; // the HEF ends in a sigmoid
+        detect_yolov5(heads, options, detections);
+        write_detections_as_yolov5_rows(detections, layout.rows(), result.objectDetectionResult);
+        return;
+    }
+
+    // The HEF ends in a sigmoid, so only the box terms need decoding.
+    if (pool)
+        decode_yolov5_parallel(heads, false, result.objectDetectionResult, *pool);
+    else
+        decode_yolov5(heads, false, result.objectDetectionResult);
+}
+
+// HEFs compiled with on-chip NMS deliver one NMS-by-class buffer instead of raw heads. The boxes
+// are parsed straight into a per-thread detection buffer that keeps its capacity across frames.
+void decode_nms_frame(const InferenceCompletion &completion, BMTResult &result, size_t classes,
+                      int input_w, int input_h, size_t rows, const BoxMapping &boxes)
+{
+    static thread_local vector<Coco17DetectionResult> detections;
+    const TensorView &output = completion.outputs.front();
+    parse_nms_data(output.data, output.size_bytes, classes, input_w, input_h, detections, rows);
+    boxes.apply(detections);
+    write_detections_as_yolov5_rows(detections, rows, result.objectDetectionResult);
+}
+
+class Virtual_Submitter_Implementation : public AI_BMT_Interface
+{
+    unique_ptr<AsyncPipeline> pipeline;
+    YoloV5LayoutPlan layout;
+    unique_ptr<LetterboxPreprocessor> letterbox;
+    size_t nms_classes = 0; // > 0: the HEF ends in on-chip NMS
+    size_t result_rows = 0;
+    LetterboxTransformTable transforms; // keyed by the preprocessed frame's pixels
+
+public:
+    Virtual_Submitter_Implementation()
+    {
+    }
+
+    virtual Optional_Data getOptionalData() override
+    {
+        Optional_Data data;
+        data.cpu_type = "Broadcom BCM2712 quad-core Arm Cortex A76 processor @ 2.4GHz"; // e.g., Intel i7-9750HF
+        data.accelerator_type = "Hailo-8";                                              // e.g., DeepX M1(NPU)
+        data.submitter = "Hailo";                                                       // e.g., DeepX
+        data.cpu_core_count = "4";                                                      // e.g., 16
+        data.cpu_ram_capacity = "8GB";                                                  // e.g., 32GB
+        data.cooling = "Air";                                                           // e.g., Air, Liquid, Passive
+        data.cooling_option = "Active";                                                 // e.g., Active, Passive (Active = with fan/pump, Passive = without fan)
+        data.cpu_accelerator_interconnect_interface = "PCIe 3.0 4-lane";                // e.g., PCIe Gen5 x16
+        data.benchmark_model = "YoloV5";                                                // e.g., ResNet-50
+        data.operating_system = "Ubuntu 24.04.2 LTS";                                   // e.g., Ubuntu 20.04.5 LTS
+        return data;
+    }
+
+    virtual void Initialize(string modelPath) override
+    {
+        // Every Hailo device on the host gets its own backend; frames are spread across them.
+        auto backends = create_hailo_backends(modelPath, NATIVE_OUTPUT_FORMAT ? HAILO_FORMAT_TYPE_AUTO : HAILO_FORMAT_TYPE_FLOAT32);
+        auto model = static_pointer_cast<HailoBackend>(backends.front())->model();
+        const auto &first_output = model->get_outputs().front();
+        if (first_output.is_nms())
+        {
+            nms_classes = first_output.get_nms_shape().number_of_classes;
+            if (nms_classes > static_cast<size_t>(YOLOV5_ATTRIBUTES - 5))
+                throw runtime_error("On-chip NMS reports " + to_string(nms_classes) + " classes; the harness rows hold " +
+                                    to_string(YOLOV5_ATTRIBUTES - 5));
+            hailo_3d_image_shape_t input = model->get_input_shape();
+            layout.input_h = static_cast<int>(input.height);
+            layout.input_w = static_cast<int>(input.width);
+            result_rows = yolov5_row_count(layout.input_h, layout.input_w);
+        }
+        else
+        {
+            layout = plan_hailo_yolov5_layout(*model);
+            result_rows = layout.rows();
+        }
+        cout << "-I- Input " << layout.input_w << "x" << layout.input_h << ", " << result_rows << " candidate rows"
+             << (nms_classes ? ", on-chip NMS" : "") << endl;
+        letterbox = make_unique<LetterboxPreprocessor>(layout.input_w, layout.input_h);
+        pipeline = make_unique<AsyncPipeline>(combine_backends(backends), DECODE_THREADS);
+    }
+
+    virtual VariantType convertToPreprocessedDataForInference(const string &imagePath) override
+    {
+        // Letterboxed (aspect kept, 114 border) and RGB in one pass; the transform is recorded
+        // against the frame's pixels so the decode can map the boxes back.
+        cv::Mat img = decode_image(imagePath);
+        vector<uint8_t> inputBuf(letterbox->frame_size());
+        LetterboxTransform transform = letterbox->run(img.data, img.cols, img.rows, img.step, inputBuf.data());
+        transforms.record(inputBuf.data(), inputBuf.size(), transform);
+        return inputBuf;
+    }
+
+    virtual vector<BMTResult> runInference(const vector<VariantType> &data) override
+    {
+        vector<BMTResult> batchResult;
+        WorkerPool *pool = pipeline->decode_pool();
+        const size_t frame_size = letterbox->frame_size();
+        PipelineStats stats = pipeline->run(data, batchResult, [this, pool, &data, frame_size](const InferenceCompletion &completion, BMTResult &result)
+                                            {
+                                                // Looked up on the decode threads, where hashing the frame costs the
+                                                // submission nothing. The harness scores boxes against a plain resize
+                                                // to the input size.
+                                                auto bytes = variant_bytes(data[completion.frame_idx], frame_size);
+                                                BoxMapping boxes = transforms.find(bytes.first, frame_size)
+                                                                       .to_resized(layout.input_w, layout.input_h);
+                                                if (nms_classes)
+                                                    decode_nms_frame(completion, result, nms_classes, layout.input_w, layout.input_h, result_rows, boxes);
+                                                else
+                                                    decode_yolov5_frame(layout, completion, result, boxes, pool);
+                                            });
+        if (stats.failed_frames > 0)
+        {
+            // Keep going: a frame the device failed on reports no detections instead of aborting the run.
+            cerr << "-W- " << stats.failed_frames << " of " << stats.frames << " frames failed" << endl;
+            for (auto &result : batchResult)
+            {
+                if (result.objectDetectionResult.empty())
+                    result.objectDetectionResult.assign(result_rows * YOLOV5_ATTRIBUTES, 0.0f);
+            }
+        }
+        return batchResult;
+    }
+};
+
+int main(int argc, char *argv[])
+{
+    filesystem::path exePath = filesystem::absolute(argv[0]).parent_path(); // Get the current executable file path
+    filesystem::path model_path = exePath / "Model" / "ObjectDetection" / "yolov5n_opset12_normalized_quantized.hef";
+    string modelPath = model_path.string();
+    try
+    {
+        // sample_latency_average: 46.3471 ms (without post processing)
+        // sample_latency_average: 64.8433 ms (with post processing)
+
+        shared_ptr<AI_BMT_Interface> interface = make_shared<Virtual_Submitter_Implementation>();
+        AI_BMT_GUI_CALLER caller(interface, modelPath);
+        return caller.call_BMT_GUI(argc, argv);
+    }
+    catch (const exception &ex)
+    {
+        cout << ex.what() << endl;
+    }
+}
@@ -0,0 +1,257 @@
+#ifndef _DETECTION_DECODERS_HPP_
+#define _DETECTION_DECODERS_HPP_
+
+#include "yolo_postprocess.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Detection decoders for the YOLO output formats the examples meet, turning a
+// model's output tensor(s) into Coco17DetectionResult records:
+//
+//   YoloV5GridDecoder     3 raw heads {1, H, W, 3 * (5 + C)} (Hailo, DeepX)
+//   YoloV5FlatDecoder     {1, 25200, 5 + C}, boxes already decoded (ONNX export)
+//   YoloV8Decoder         {1, 4 + C, 8400}, anchor-free, no objectness (v5u/v8/v9/11/12)
+//   YoloV10Decoder        {1, 300, 6} = x1, y1, x2, y2, score, class, NMS-free
+//
+// Class count and layout of the flat heads are template parameters so the inner
+// loops are specialized at compile time; NumClasses = 0 keeps the class count a
+// runtime value for models that are not COCO-80. The grid heads take theirs from
+// the channel count (channels / 3 - 5). create_detection_decoder() picks the
+// decoder from the output shapes and the network input size.
+// ─────────────────────────────────────────────────────────────────────────────
+
+constexpr int COCO_CLASSES = 80;
+
+class DetectionDecoder {
+public:
+    virtual ~DetectionDecoder() = default;
+    virtual std::string name() const = 0;
+    // outputs in the order of the shapes the decoder was created from.
+    virtual void detect(const std::vector<const float *> &outputs, const DetectionOptions &options,
+                        std::vector<Coco17DetectionResult> &detections) const = 0;
+};
+
+namespace detection_detail {
+
+template <int NumClasses>
+struct ClassCount {
+    explicit ClassCount(int) {}
+    static constexpr int value() { return NumClasses; }
+};
+template <>
+struct ClassCount<0> {
+    int count;
+    explicit ClassCount(int n) : count(n) {}
+    int value() const { return count; }
+};
+
+inline std::string shape_string(const std::vector<int64_t> &shape)
+{
+    std::string s = "{";
+    for (size_t i = 0; i < shape.size(); ++i) {
+        s += (i ? ", " : "") + std::to_string(shape[i]);
+    }
+    return s + "}";
+}
+
+} // namespace detection_detail
+
+// Raw NHWC heads decoded with the fused path from yolo_postprocess.hpp. Head order does not
+// matter: each head's stride (and with it its anchors) follows from its grid size.
+template <typename Anchors = YoloV5Anchors>
+class YoloV5GridDecoder : public DetectionDecoder {
+private:
+    YoloV5LayoutPlan m_plan;
+
+    static std::vector<YoloV5HeadShape> head_shapes(const std::vector<std::vector<int64_t>> &shapes) {
+        std::vector<YoloV5HeadShape> heads;
+        for (const auto &shape : shapes) {
+            YoloV5HeadShape head;
+            head.grid_h = static_cast<int>(shape[1]);
+            head.grid_w = static_cast<int>(shape[2]);
+            head.channels = static_cast<int>(shape[3]);
+            heads.push_back(head);
+        }
+        return heads;
+    }
+
+public:
+    YoloV5GridDecoder(const std::vector<std::vector<int64_t>> &shapes, int input_h, int input_w)
+        : m_plan(plan_yolov5_layout<Anchors>(head_shapes(shapes), input_h, input_w)) {}
+
+    std::string name() const override {
+        return "YOLOv5 grid heads x" + std::to_string(m_plan.heads.size()) + ", " + std::to_string(m_plan.heads.front().classes) + " classes";
+    }
+
+    const YoloV5LayoutPlan &plan() const { return m_plan; }
+
+    void detect(const std::vector<const float *> &outputs, const DetectionOptions &options,
+                std::vector<Coco17DetectionResult> &detections) const override {
+        thread_local std::vector<YoloV5Head> heads;
+        m_plan.bind(heads, [&outputs](size_t i) { return outputs[i]; });
+        detect_yolov5(heads, options, detections);
+    }
+};
+
+// {1, N, 5 + C} with [cx, cy, w, h, obj, class scores] already activated.
+template <int NumClasses = COCO_CLASSES>
+class YoloV5FlatDecoder : public DetectionDecoder {
+private:
+    size_t m_rows;
+    detection_detail::ClassCount<NumClasses> m_classes;
+
+public:
+    YoloV5FlatDecoder(size_t rows, int num_classes) : m_rows(rows), m_classes(num_classes) {}
+
+    std::string name() const override { return "YOLOv5 {1, " + std::to_string(m_rows) + ", " + std::to_string(5 + m_classes.value()) + "}"; }
+
+    void detect(const std::vector<const float *> &outputs, const DetectionOptions &options,
+                std::vector<Coco17DetectionResult> &detections) const override {
+        const int classes = m_classes.value();
+        const int row_size = 5 + classes;
+        detections.clear();
+        const float *row = outputs[0];
+        for (size_t r = 0; r < m_rows; ++r, row += row_size) {
+            if (row[4] < options.conf_threshold) continue;
+            yolo_detail::add_class_candidates(row + 5, classes, row[4], row[0] - 0.5f * row[2], row[1] - 0.5f * row[3],
+                                              row[2], row[3], options, detections);
+        }
+        non_max_suppression(detections, options);
+    }
+};
+
+// Anchor-free head: {1, 4 + C, N} (Transposed, the usual export) or {1, N, 4 + C}; [cx, cy, w, h]
+// then class scores, no objectness.
+template <int NumClasses = COCO_CLASSES, bool Transposed = true>
+class YoloV8Decoder : public DetectionDecoder {
+private:
+    size_t m_candidates;
+    detection_detail::ClassCount<NumClasses> m_classes;
+
+public:
+    YoloV8Decoder(size_t candidates, int num_classes) : m_candidates(candidates), m_classes(num_classes) {}
+
+    std::string name() const override {
+        return std::string("YOLOv8-style ") + (Transposed ? "{1, " + std::to_string(4 + m_classes.value()) + ", " + std::to_string(m_candidates) + "}"
+                                                          : "{1, " + std::to_string(m_candidates) + ", " + std::to_string(4 + m_classes.value()) + "}");
+    }
+
+    void detect(const std::vector<const float *> &outputs, const DetectionOptions &options,
+                std::vector<Coco17DetectionResult> &detections) const override {
+        const int classes = m_classes.value();
+        const size_t n = m_candidates;
+        const float *out = outputs[0];
+        detections.clear();
+        if (Transposed && options.multi_label) {
+            // Channel-major, every class above the threshold: one sequential pass per class plane,
+            // boxes read only for the hits.
+            for (int c = 0; c < classes; ++c) {
+                const float *plane = out + (4 + static_cast<size_t>(c)) * n;
+                for (size_t i = 0; i < n; ++i) {
+                    if (plane[i] < options.conf_threshold) continue;
+                    float w = out[2 * n + i], h = out[3 * n + i];
+                    detections.emplace_back(c, out[i] - 0.5f * w, out[n + i] - 0.5f * h, w, h, plane[i]);
+                }
+            }
+        } else if (Transposed) {
+            // Channel-major, best class only: scan class planes first so the memory walk stays
+            // sequential, keeping each candidate's best score, then decode boxes only for
+            // candidates that pass.
+            thread_local std::vector<float> best_score;
+            thread_local std::vector<int> best_class;
+            best_score.assign(n, 0.0f);
+            best_class.assign(n, 0);
+            for (int c = 0; c < classes; ++c) {
+                const float *plane = out + (4 + static_cast<size_t>(c)) * n;
+                for (size_t i = 0; i < n; ++i) {
+                    if (plane[i] > best_score[i]) {
+                        best_score[i] = plane[i];
+                        best_class[i] = c;
+                    }
+                }
+            }
+            for (size_t i = 0; i < n; ++i) {
+                if (best_score[i] < options.conf_threshold) continue;
+                float w = out[2 * n + i], h = out[3 * n + i];
+                detections.emplace_back(best_class[i], out[i] - 0.5f * w, out[n + i] - 0.5f * h, w, h, best_score[i]);
+            }
+        } else {
+            const float *row = out;
+            for (size_t i = 0; i < n; ++i, row += 4 + classes) {
+                yolo_detail::add_class_candidates(row + 4, classes, 1.0f, row[0] - 0.5f * row[2], row[1] - 0.5f * row[3],
+                                                  row[2], row[3], options, detections);
+            }
+        }
+        non_max_suppression(detections, options);
+    }
+};
+
+// End-to-end head: {1, K, 6} rows of [x1, y1, x2, y2, score, class], already NMS-free.
+class YoloV10Decoder : public DetectionDecoder {
+private:
+    size_t m_rows;
+
+public:
+    explicit YoloV10Decoder(size_t rows) : m_rows(rows) {}
+
+    std::string name() const override { return "YOLOv10 {1, " + std::to_string(m_rows) + ", 6}"; }
+
+    void detect(const std::vector<const float *> &outputs, const DetectionOptions &options,
+                std::vector<Coco17DetectionResult> &detections) const override {
+        detections.clear();
+        const float *row = outputs[0];
+        for (size_t r = 0; r < m_rows && detections.size() < options.max_detections; ++r, row += 6) {
+            if (row[4] < options.conf_threshold) continue;
+            detections.emplace_back(static_cast<int>(row[5]), row[0], row[1], row[2] - row[0], row[3] - row[1], row[4]);
+        }
+    }
+};
+
+// Picks the decoder for a model from its output shapes (batch dimension first) and its network
+// input size; the candidate count tells anchor-based (3 per cell) from anchor-free heads. Throws
+// if the shapes match no known layout.
+inline std::unique_ptr<DetectionDecoder> create_detection_decoder(const std::vector<std::vector<int64_t>> &shapes,
+                                                                  int input_h, int input_w)
+{
+    size_t cells = 0;
+    for (int stride : YoloV5Anchors::strides) {
+        cells += static_cast<size_t>(input_h / stride) * (input_w / stride);
+    }
+
+    if (shapes.size() == 3 && std::all_of(shapes.begin(), shapes.end(), [](const std::vector<int64_t> &s) { return s.size() == 4; })) {
+        return std::make_unique<YoloV5GridDecoder<YoloV5Anchors>>(shapes, input_h, input_w);
+    }
+    if (shapes.size() == 1 && shapes[0].size() == 3) {
+        const int64_t d1 = shapes[0][1], d2 = shapes[0][2];
+        if (d2 == 6 && d1 < static_cast<int64_t>(cells)) {
+            return std::make_unique<YoloV10Decoder>(static_cast<size_t>(d1));
+        }
+        if (d1 == static_cast<int64_t>(3 * cells) && d2 > 5) {
+            const int classes = static_cast<int>(d2 - 5);
+            if (classes == COCO_CLASSES) return std::make_unique<YoloV5FlatDecoder<COCO_CLASSES>>(d1, classes);
+            return std::make_unique<YoloV5FlatDecoder<0>>(d1, classes);
+        }
+        if (d2 == static_cast<int64_t>(cells) && d1 > 4) {
+            const int classes = static_cast<int>(d1 - 4);
+            if (classes == COCO_CLASSES) return std::make_unique<YoloV8Decoder<COCO_CLASSES, true>>(d2, classes);
+            return std::make_unique<YoloV8Decoder<0, true>>(d2, classes);
+        }
+        if (d1 == static_cast<int64_t>(cells) && d2 > 4) {
+            const int classes = static_cast<int>(d2 - 4);
+            if (classes == COCO_CLASSES) return std::make_unique<YoloV8Decoder<COCO_CLASSES, false>>(d1, classes);
+            return std::make_unique<YoloV8Decoder<0, false>>(d1, classes);
+        }
+    }
+
+    std::string described;
+    for (const auto &shape : shapes) described += detection_detail::shape_string(shape) + " ";
+    throw std::runtime_error("No detection decoder for output shapes " + described);
+}
+
+#endif /* _DETECTION_DECODERS_HPP_ */
@@ -0,0 +1,110 @@
+#ifndef _FAST_MATH_HPP_
+#define _FAST_MATH_HPP_
+
+#include "simd_math.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// exp/sigmoid variants for the postprocessing loops. Each call site picks its own trade-off;
+// the errors below are the maxima measured over [-20, 20] against the double-precision result.
+enum class SigmoidApprox {
+    EXACT, // 1 / (1 + e^-x) with std::exp, or the Cephes vector exp: abs. error < 1e-7
+    POLY,  // e^x as 2^n * cubic(f): exp rel. error < 8.7e-5, sigmoid abs. error < 2.2e-5
+    LUT    // 2049-entry table over [-16, 16], linear interpolation: abs. error < 3e-6. Scalar
+           // only: NEON/SSE2 have no gather, so the vector paths run POLY instead.
+};
+
+namespace fast_math {
+
+// Cubic minimax fit of 2^f on [0, 1) with p(0) = 1.
+constexpr float EXP2_C1 = 0.695116103f;
+constexpr float EXP2_C2 = 0.227648005f;
+constexpr float EXP2_C3 = 0.0770642757f;
+
+constexpr float SIGMOID_LUT_RANGE = 16.0f;
+constexpr int SIGMOID_LUT_STEPS_PER_UNIT = 64;
+constexpr int SIGMOID_LUT_SIZE = static_cast<int>(2 * SIGMOID_LUT_RANGE) * SIGMOID_LUT_STEPS_PER_UNIT + 1;
+
+// e^x with a relative error below 8.7e-5; x is clamped to [-87, 88].
+inline float exp_poly(float x)
+{
+    x = std::min(std::max(x, -87.0f), 88.0f);
+    float t = x * 1.44269504088896341f;
+    float n = std::floor(t);
+    float f = t - n;
+    float p = ((EXP2_C3 * f + EXP2_C2) * f + EXP2_C1) * f + 1.0f;
+    int32_t bits = (static_cast<int32_t>(n) + 127) << 23;
+    float scale;
+    std::memcpy(&scale, &bits, sizeof(scale));
+    return p * scale;
+}
+
+inline const std::array<float, SIGMOID_LUT_SIZE> &sigmoid_table()
+{
+    static const std::array<float, SIGMOID_LUT_SIZE> table = [] {
+        std::array<float, SIGMOID_LUT_SIZE> t{};
+        for (int i = 0; i < SIGMOID_LUT_SIZE; ++i) {
+            double x = -SIGMOID_LUT_RANGE + static_cast<double>(i) / SIGMOID_LUT_STEPS_PER_UNIT;
+            t[i] = static_cast<float>(1.0 / (1.0 + std::exp(-x)));
+        }
+        return t;
+    }();
+    return table;
+}
+
+inline float sigmoid_lut(float x)
+{
+    const auto &table = sigmoid_table();
+    float pos = (std::min(std::max(x, -SIGMOID_LUT_RANGE), SIGMOID_LUT_RANGE) + SIGMOID_LUT_RANGE) * SIGMOID_LUT_STEPS_PER_UNIT;
+    int i = std::min(static_cast<int>(pos), SIGMOID_LUT_SIZE - 2);
+    float frac = pos - i;
+    return table[i] + frac * (table[i + 1] - table[i]);
+}
+
+inline float sigmoid(float x, SigmoidApprox approx = SigmoidApprox::EXACT)
+{
+    switch (approx) {
+        case SigmoidApprox::POLY: return 1.0f / (1.0f + exp_poly(-x));
+        case SigmoidApprox::LUT:  return sigmoid_lut(x);
+        default:                  return 1.0f / (1.0f + std::exp(-x));
+    }
+}
+
+} // namespace fast_math
+
+#if SIMD_MATH_ENABLED
+namespace simd {
+
+// Vector fast_math::exp_poly, same error bound.
+inline f32x4 exp_poly(f32x4 x)
+{
+    x = min(max(x, set1(-87.0f)), set1(88.0f));
+    f32x4 t = mul(x, set1(1.44269504088896341f));
+    f32x4 n = floor(t);
+    f32x4 f = sub(t, n);
+    f32x4 p = add(mul(set1(fast_math::EXP2_C3), f), set1(fast_math::EXP2_C2));
+    p = add(mul(p, f), set1(fast_math::EXP2_C1));
+    p = add(mul(p, f), set1(1.0f));
+    return mul(p, pow2i(to_int_trunc(n)));
+}
+
+inline f32x4 sigmoid(f32x4 x, SigmoidApprox approx)
+{
+    const f32x4 one = set1(1.0f);
+    switch (approx) {
+        case SigmoidApprox::POLY:
+        case SigmoidApprox::LUT: // a lane-by-lane lookup is slower than EXACT here
+            return div(one, add(one, exp_poly(neg(x))));
+        default:
+            return sigmoid(x);
+    }
+}
+
+} // namespace simd
+#endif
+
+#endif /* _FAST_MATH_HPP_ */
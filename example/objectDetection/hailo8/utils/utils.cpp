@@ -354,11 +354,14 @@ std::vector<NamedBbox> parse_nms_data(uint8_t* data, size_t max_class_count) {
     size_t offset = 0;
 
     for (size_t class_id = 0; class_id < max_class_count; class_id++) {
-        auto det_count = static_cast<uint32_t>(*reinterpret_cast<float32_t*>(data + offset));
+        float32_t count_value;
+        std::memcpy(&count_value, data + offset, sizeof(count_value));
+        auto det_count = static_cast<uint32_t>(count_value);
         offset += sizeof(float32_t);
 
         for (size_t j = 0; j < det_count; j++) {
-            hailo_bbox_float32_t bbox_data = *reinterpret_cast<hailo_bbox_float32_t*>(data + offset);
+            hailo_bbox_float32_t bbox_data;
+            std::memcpy(&bbox_data, data + offset, sizeof(bbox_data));
             offset += sizeof(hailo_bbox_float32_t);
 
             NamedBbox named_bbox;
@@ -370,6 +373,37 @@ std::vector<NamedBbox> parse_nms_data(uint8_t* data, size_t max_class_count) {
     return bboxes;
 }
 
+size_t parse_nms_data(const uint8_t *data, size_t data_size, size_t max_class_count,
+                      int org_width, int org_height, std::vector<Coco17DetectionResult> &detections,
+                      size_t max_detections) {
+    detections.clear();
+    const float width = static_cast<float>(org_width);
+    const float height = static_cast<float>(org_height);
+    size_t offset = 0;
+
+    // The buffer is packed, so counts and boxes can sit at any alignment: memcpy loads only.
+    for (size_t class_id = 0; class_id < max_class_count && offset + sizeof(float32_t) <= data_size; class_id++) {
+        float32_t count_value;
+        std::memcpy(&count_value, data + offset, sizeof(count_value));
+        offset += sizeof(float32_t);
+        size_t det_count = static_cast<size_t>(count_value);
+        det_count = std::min(det_count, (data_size - offset) / sizeof(hailo_bbox_float32_t));
+
+        for (size_t j = 0; j < det_count; j++, offset += sizeof(hailo_bbox_float32_t)) {
+            if (detections.size() >= max_detections) {
+                return detections.size();
+            }
+            hailo_bbox_float32_t bbox;
+            std::memcpy(&bbox, data + offset, sizeof(bbox));
+            detections.emplace_back(static_cast<int>(class_id),
+                                    bbox.x_min * width, bbox.y_min * height,
+                                    (bbox.x_max - bbox.x_min) * width, (bbox.y_max - bbox.y_min) * height,
+                                    bbox.score);
+        }
+    }
+    return detections.size();
+}
+
 cv::VideoCapture open_video_capture(const std::string &input_path, cv::VideoCapture capture,
                                     double &org_height, double &org_width, size_t &frame_count) {
     capture.open(input_path, cv::CAP_ANY); 
@@ -0,0 +1,439 @@
+#ifndef _YOLO_DECODE_HPP_
+#define _YOLO_DECODE_HPP_
+
+#include "fast_math.hpp"
+#include "simd_math.hpp"
+#include "worker_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// YOLOv5 head decode into the {1, 25200, 85} layout the BMT harness expects: for every head,
+// cell (y, x) and anchor a one row of [cx, cy, w, h, objectness, 80 class scores].
+constexpr int YOLOV5_ATTRIBUTES = 85;
+constexpr int YOLOV5_ANCHORS_PER_CELL = 3;
+
+// Element type of a head. Quantized heads are dequantized inside the decode kernels as they are
+// read (real = (q - zero_point) * scale), so the device can hand over its native uint8/uint16
+// output and no float copy of the head is made.
+enum class YoloV5HeadFormat {
+    FLOAT32,
+    UINT8,
+    UINT16
+};
+
+// One output head in NHWC order. cell_stride is the channel count per cell: 3 * 85 = 255 on
+// Hailo, padded to 256 on DeepX. Each anchor holds 5 + classes values.
+struct YoloV5Head {
+    const void *data = nullptr; // float, uint8_t or uint16_t elements, see format
+    int grid_h = 0;
+    int grid_w = 0;
+    int cell_stride = YOLOV5_ANCHORS_PER_CELL * YOLOV5_ATTRIBUTES;
+    int classes = YOLOV5_ATTRIBUTES - 5; // the decode into harness rows needs COCO's 80
+    float stride = 0.0f;
+    float anchors[YOLOV5_ANCHORS_PER_CELL][2] = {};
+    YoloV5HeadFormat format = YoloV5HeadFormat::FLOAT32;
+    float scale = 1.0f;
+    float zero_point = 0.0f;
+    // Decoded boxes come out as x' = x * box_scale[0] + box_offset[0] (y likewise, sizes only
+    // scaled), e.g. to undo a letterbox within the decode; see map_boxes.
+    float box_scale[2] = {1.0f, 1.0f};
+    float box_offset[2] = {0.0f, 0.0f};
+
+    void map_boxes(float scale_x, float scale_y, float offset_x, float offset_y) {
+        box_scale[0] = scale_x;
+        box_scale[1] = scale_y;
+        box_offset[0] = offset_x;
+        box_offset[1] = offset_y;
+    }
+
+    size_t rows() const { return static_cast<size_t>(grid_h) * grid_w * YOLOV5_ANCHORS_PER_CELL; }
+    size_t rows_per_grid_row() const { return static_cast<size_t>(grid_w) * YOLOV5_ANCHORS_PER_CELL; }
+};
+
+// Anchor sets, as types so a decoder can be specialized on them.
+struct YoloV5Anchors {
+    static constexpr int strides[3] = {8, 16, 32};
+    static constexpr float anchors[3][3][2] = {
+        {{10, 13}, {16, 30}, {33, 23}},     // P3
+        {{30, 61}, {62, 45}, {59, 119}},    // P4
+        {{116, 90}, {156, 198}, {373, 326}} // P5
+    };
+};
+
+// A raw head as the runtime reports it: grid size, channels per cell and element type.
+struct YoloV5HeadShape {
+    int grid_h = 0;
+    int grid_w = 0;
+    int channels = 0;
+    YoloV5HeadFormat format = YoloV5HeadFormat::FLOAT32;
+    float scale = 1.0f;
+    float zero_point = 0.0f;
+};
+
+// Which output tensor feeds which head, worked out once per model. heads are in output-row order
+// (finest grid first, as the harness expects) without data; heads[i] reads tensor source[i].
+struct YoloV5LayoutPlan {
+    std::vector<YoloV5Head> heads;
+    std::vector<size_t> source;
+    int input_h = 0;
+    int input_w = 0;
+
+    size_t rows() const {
+        size_t total = 0;
+        for (const auto &head : heads) total += head.rows();
+        return total;
+    }
+
+    // bound = heads, each pointing at data_of(tensor index). Reusing bound avoids reallocating.
+    template <typename DataOf>
+    void bind(std::vector<YoloV5Head> &bound, DataOf data_of) const {
+        bound = heads;
+        for (size_t i = 0; i < bound.size(); ++i) bound[i].data = data_of(source[i]);
+    }
+};
+
+// Candidate rows of a YOLOv5 model at this input size (25200 at 640x640).
+template <typename Anchors = YoloV5Anchors>
+inline size_t yolov5_row_count(int input_h, int input_w)
+{
+    size_t rows = 0;
+    for (int stride : Anchors::strides) {
+        rows += static_cast<size_t>(input_h / stride) * (input_w / stride) * YOLOV5_ANCHORS_PER_CELL;
+    }
+    return rows;
+}
+
+// Stride = input size / grid size, and the stride picks the anchors, so the same code serves
+// 320/416/640 inputs and any output order. The class count is channels / 3 - 5 (padding cut off).
+// Throws if a head matches no stride of Anchors.
+template <typename Anchors = YoloV5Anchors>
+inline YoloV5LayoutPlan plan_yolov5_layout(const std::vector<YoloV5HeadShape> &shapes, int input_h, int input_w)
+{
+    YoloV5LayoutPlan plan;
+    plan.input_h = input_h;
+    plan.input_w = input_w;
+    std::vector<size_t> order(shapes.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&shapes](size_t a, size_t b) { return shapes[a].grid_w > shapes[b].grid_w; });
+
+    for (size_t index : order) {
+        const YoloV5HeadShape &shape = shapes[index];
+        const std::string described = std::to_string(shape.grid_h) + "x" + std::to_string(shape.grid_w) + "x" + std::to_string(shape.channels);
+        if (shape.grid_h <= 0 || shape.grid_w <= 0 || input_h % shape.grid_h != 0 || input_w % shape.grid_w != 0 ||
+            input_h / shape.grid_h != input_w / shape.grid_w) {
+            throw std::runtime_error("YOLOv5 head " + described + " does not tile the " + std::to_string(input_h) + "x" +
+                                     std::to_string(input_w) + " input");
+        }
+        const int classes = shape.channels / YOLOV5_ANCHORS_PER_CELL - 5;
+        if (classes < 1) {
+            throw std::runtime_error("YOLOv5 head " + described + " has fewer than " +
+                                     std::to_string(YOLOV5_ANCHORS_PER_CELL * 6) + " channels");
+        }
+        const int stride = input_w / shape.grid_w;
+        const int *level = std::find(std::begin(Anchors::strides), std::end(Anchors::strides), stride);
+        if (level == std::end(Anchors::strides)) {
+            throw std::runtime_error("YOLOv5 head " + described + " has stride " + std::to_string(stride) + ", no anchors for it");
+        }
+
+        YoloV5Head head;
+        head.grid_h = shape.grid_h;
+        head.grid_w = shape.grid_w;
+        head.cell_stride = shape.channels;
+        head.classes = classes;
+        head.stride = static_cast<float>(stride);
+        head.format = shape.format;
+        head.scale = shape.scale;
+        head.zero_point = shape.zero_point;
+        const auto &level_anchors = Anchors::anchors[level - std::begin(Anchors::strides)];
+        std::copy(&level_anchors[0][0], &level_anchors[0][0] + 2 * YOLOV5_ANCHORS_PER_CELL, &head.anchors[0][0]);
+        plan.heads.push_back(head);
+        plan.source.push_back(index);
+    }
+    return plan;
+}
+
+namespace yolo_detail {
+
+// Reads a head's elements as floats by offset; the kernels are written once against this.
+struct FloatReader {
+    const float *base;
+    explicit FloatReader(const YoloV5Head &head) : base(static_cast<const float *>(head.data)) {}
+    float at(size_t i) const { return base[i]; }
+#if SIMD_MATH_ENABLED
+    simd::f32x4 load(size_t i) const { return simd::load(base + i); }
+#endif
+};
+
+template <typename T>
+struct QuantizedReader {
+    const T *base;
+    float scale;
+    float zero_point;
+    explicit QuantizedReader(const YoloV5Head &head)
+        : base(static_cast<const T *>(head.data)), scale(head.scale), zero_point(head.zero_point) {}
+    float at(size_t i) const { return (static_cast<float>(base[i]) - zero_point) * scale; }
+#if SIMD_MATH_ENABLED
+    simd::f32x4 load(size_t i) const {
+        simd::f32x4 q;
+        if constexpr (std::is_same<T, uint8_t>::value) q = simd::load_u8(base + i);
+        else q = simd::load_u16(base + i);
+        return simd::mul(simd::sub(q, simd::set1(zero_point)), simd::set1(scale));
+    }
+#endif
+};
+
+// The row decode writes the harness's 85-wide rows, so it only takes 80-class heads.
+inline void check_harness_classes(const YoloV5Head &head)
+{
+    if (YOLOV5_ATTRIBUTES - 5 != head.classes) {
+        throw std::runtime_error("YOLOv5 decode: head has " + std::to_string(head.classes) + " classes, the " +
+                                 std::to_string(YOLOV5_ATTRIBUTES) + "-wide rows need " + std::to_string(YOLOV5_ATTRIBUTES - 5));
+    }
+}
+
+// Calls fn with the reader that matches head.format.
+template <typename Fn>
+inline void with_head_reader(const YoloV5Head &head, Fn &&fn)
+{
+    switch (head.format) {
+        case YoloV5HeadFormat::UINT8:  fn(QuantizedReader<uint8_t>(head)); break;
+        case YoloV5HeadFormat::UINT16: fn(QuantizedReader<uint16_t>(head)); break;
+        default:                       fn(FloatReader(head)); break;
+    }
+}
+
+template <typename Reader>
+inline void decode_head_scalar(const YoloV5Head &head, const Reader &in, bool apply_sigmoid, float *out,
+                               SigmoidApprox score_sigmoid, int y_begin, int y_end)
+{
+    auto activate = [apply_sigmoid](float v) { return apply_sigmoid ? fast_math::sigmoid(v) : v; };
+    const float stride_x = head.stride * head.box_scale[0], stride_y = head.stride * head.box_scale[1];
+    out += y_begin * head.rows_per_grid_row() * YOLOV5_ATTRIBUTES;
+    for (int y = y_begin; y < y_end; ++y) {
+        for (int x = 0; x < head.grid_w; ++x) {
+            const size_t cell = (static_cast<size_t>(y) * head.grid_w + x) * head.cell_stride;
+            for (int a = 0; a < YOLOV5_ANCHORS_PER_CELL; ++a, out += YOLOV5_ATTRIBUTES) {
+                const size_t raw = cell + a * YOLOV5_ATTRIBUTES;
+                float tx = activate(in.at(raw + 0)) * 2.0f;
+                float ty = activate(in.at(raw + 1)) * 2.0f;
+                float tw = activate(in.at(raw + 2)) * 2.0f;
+                float th = activate(in.at(raw + 3)) * 2.0f;
+                out[0] = (tx - 0.5f + x) * stride_x + head.box_offset[0];
+                out[1] = (ty - 0.5f + y) * stride_y + head.box_offset[1];
+                out[2] = tw * tw * head.anchors[a][0] * head.box_scale[0];
+                out[3] = th * th * head.anchors[a][1] * head.box_scale[1];
+                for (int c = 4; c < YOLOV5_ATTRIBUTES; ++c) {
+                    out[c] = apply_sigmoid ? fast_math::sigmoid(in.at(raw + c), score_sigmoid) : in.at(raw + c);
+                }
+            }
+        }
+    }
+}
+
+#if SIMD_MATH_ENABLED
+template <typename Reader>
+inline void decode_head_simd(const YoloV5Head &head, const Reader &in, bool apply_sigmoid, float *out,
+                             SigmoidApprox score_sigmoid, int y_begin, int y_end)
+{
+    static_assert(YOLOV5_ATTRIBUTES >= 8, "score block must span at least one vector");
+    const simd::mask4 xy_lanes = simd::lane_mask(true, true, false, false);
+    const simd::f32x4 two = simd::set1(2.0f);
+    const simd::f32x4 half = simd::set1(0.5f);
+    const simd::f32x4 stride = simd::set(head.stride * head.box_scale[0], head.stride * head.box_scale[1], 0.0f, 0.0f);
+    const simd::f32x4 offset = simd::set(head.box_offset[0], head.box_offset[1], 0.0f, 0.0f);
+    simd::f32x4 anchor_wh[YOLOV5_ANCHORS_PER_CELL];
+    for (int a = 0; a < YOLOV5_ANCHORS_PER_CELL; ++a) {
+        anchor_wh[a] = simd::set(0.0f, 0.0f, head.anchors[a][0] * head.box_scale[0], head.anchors[a][1] * head.box_scale[1]);
+    }
+
+    out += y_begin * head.rows_per_grid_row() * YOLOV5_ATTRIBUTES;
+    for (int y = y_begin; y < y_end; ++y) {
+        for (int x = 0; x < head.grid_w; ++x) {
+            const size_t cell = (static_cast<size_t>(y) * head.grid_w + x) * head.cell_stride;
+            const simd::f32x4 grid = simd::set(static_cast<float>(x), static_cast<float>(y), 0.0f, 0.0f);
+            for (int a = 0; a < YOLOV5_ANCHORS_PER_CELL; ++a, out += YOLOV5_ATTRIBUTES) {
+                const size_t raw = cell + a * YOLOV5_ATTRIBUTES;
+
+                simd::f32x4 t = in.load(raw);
+                if (apply_sigmoid) t = simd::sigmoid(t);
+                t = simd::mul(t, two);
+                simd::f32x4 xy = simd::add(simd::mul(simd::add(simd::sub(t, half), grid), stride), offset);
+                simd::f32x4 wh = simd::mul(simd::mul(t, t), anchor_wh[a]);
+                simd::store(out, simd::select(xy_lanes, xy, wh));
+
+                int c = 4;
+                for (; c + 4 <= YOLOV5_ATTRIBUTES; c += 4) {
+                    simd::f32x4 v = in.load(raw + c);
+                    simd::store(out + c, apply_sigmoid ? simd::sigmoid(v, score_sigmoid) : v);
+                }
+                if (c < YOLOV5_ATTRIBUTES) {
+                    c = YOLOV5_ATTRIBUTES - 4;
+                    simd::f32x4 v = in.load(raw + c);
+                    simd::store(out + c, apply_sigmoid ? simd::sigmoid(v, score_sigmoid) : v);
+                }
+            }
+        }
+    }
+}
+#endif
+
+} // namespace yolo_detail
+
+// apply_sigmoid: the DeepX heads are raw logits; the Hailo HEF already ends in a sigmoid.
+// score_sigmoid picks the approximation for the 81 objectness/class channels. The box terms feed
+// a squared, anchor-scaled size, so they always use the exact sigmoid; that is 4 of 85 channels.
+// out is the head's first output row; [y_begin, y_end) limits the decode to those grid rows
+// (y_end < 0: to the last row) and writes them at their usual place below out. The same holds
+// for decode_yolov5_head_simd and decode_yolov5_head.
+inline void decode_yolov5_head_scalar(const YoloV5Head &head, bool apply_sigmoid, float *out,
+                                      SigmoidApprox score_sigmoid = SigmoidApprox::EXACT,
+                                      int y_begin = 0, int y_end = -1)
+{
+    if (y_end < 0) y_end = head.grid_h;
+    yolo_detail::check_harness_classes(head);
+    yolo_detail::with_head_reader(head, [&](const auto &in) {
+        yolo_detail::decode_head_scalar(head, in, apply_sigmoid, out, score_sigmoid, y_begin, y_end);
+    });
+}
+
+#if SIMD_MATH_ENABLED
+// Same result as the scalar path (to within the vector exp's ~2e-7 relative error). The four box
+// terms of a row share one vector: all lanes get the sigmoid and 2x, then lanes 0-1 take the grid
+// offset and lanes 2-3 the anchor scaling. The 81 score channels go four at a time; the last
+// vector overlaps the previous one instead of leaving a scalar tail.
+inline void decode_yolov5_head_simd(const YoloV5Head &head, bool apply_sigmoid, float *out,
+                                    SigmoidApprox score_sigmoid = SigmoidApprox::EXACT,
+                                    int y_begin = 0, int y_end = -1)
+{
+    if (y_end < 0) y_end = head.grid_h;
+    yolo_detail::check_harness_classes(head);
+    yolo_detail::with_head_reader(head, [&](const auto &in) {
+        yolo_detail::decode_head_simd(head, in, apply_sigmoid, out, score_sigmoid, y_begin, y_end);
+    });
+}
+#endif
+
+inline void decode_yolov5_head(const YoloV5Head &head, bool apply_sigmoid, float *out,
+                               SigmoidApprox score_sigmoid = SigmoidApprox::EXACT,
+                               int y_begin = 0, int y_end = -1)
+{
+#if SIMD_MATH_ENABLED
+    decode_yolov5_head_simd(head, apply_sigmoid, out, score_sigmoid, y_begin, y_end);
+#else
+    decode_yolov5_head_scalar(head, apply_sigmoid, out, score_sigmoid, y_begin, y_end);
+#endif
+}
+
+// Decodes the heads back to back into output (resized to sum(rows) * 85) in one pass.
+inline void decode_yolov5(const std::vector<YoloV5Head> &heads, bool apply_sigmoid, std::vector<float> &output,
+                          SigmoidApprox score_sigmoid = SigmoidApprox::EXACT)
+{
+    size_t rows = 0;
+    for (const auto &head : heads) rows += head.rows();
+    output.resize(rows * YOLOV5_ATTRIBUTES);
+
+    float *out = output.data();
+    for (const auto &head : heads) {
+        decode_yolov5_head(head, apply_sigmoid, out, score_sigmoid);
+        out += head.rows() * YOLOV5_ATTRIBUTES;
+    }
+}
+
+// A band of grid rows of one head, and where that head's rows start in the output.
+struct YoloV5DecodeTile {
+    size_t head = 0;
+    int y_begin = 0;
+    int y_end = 0;
+    size_t head_offset = 0; // in floats
+};
+
+// Cuts the heads into about tile_count bands of similar cell count. The bands depend only on the
+// head shapes, so every band has a fixed place in the output no matter which thread decodes it.
+inline std::vector<YoloV5DecodeTile> plan_yolov5_tiles(const std::vector<YoloV5Head> &heads, size_t tile_count)
+{
+    size_t cells = 0;
+    for (const auto &head : heads) cells += static_cast<size_t>(head.grid_h) * head.grid_w;
+    const size_t cells_per_tile = std::max<size_t>(cells / std::max<size_t>(tile_count, 1), 1);
+
+    std::vector<YoloV5DecodeTile> tiles;
+    size_t head_offset = 0;
+    for (size_t h = 0; h < heads.size(); ++h) {
+        const int band = static_cast<int>(std::max<size_t>(cells_per_tile / std::max(heads[h].grid_w, 1), 1));
+        for (int y = 0; y < heads[h].grid_h; y += band) {
+            YoloV5DecodeTile tile;
+            tile.head = h;
+            tile.y_begin = y;
+            tile.y_end = std::min(y + band, heads[h].grid_h);
+            tile.head_offset = head_offset;
+            tiles.push_back(tile);
+        }
+        head_offset += heads[h].rows() * YOLOV5_ATTRIBUTES;
+    }
+    return tiles;
+}
+
+// decode_yolov5 with the bands spread over pool plus the calling thread; the output is identical
+// to the single-threaded decode. The caller takes bands too and only waits for bands a worker has
+// already claimed, so a busy pool (even the one the caller runs on) slows the decode but never
+// blocks it.
+inline void decode_yolov5_parallel(const std::vector<YoloV5Head> &heads, bool apply_sigmoid, std::vector<float> &output,
+                                   WorkerPool &pool, SigmoidApprox score_sigmoid = SigmoidApprox::EXACT,
+                                   size_t tile_count = 0)
+{
+    struct Job {
+        std::vector<YoloV5Head> heads;
+        std::vector<YoloV5DecodeTile> tiles;
+        bool apply_sigmoid;
+        SigmoidApprox score_sigmoid;
+        float *output;
+        std::atomic<size_t> next{0};
+        CompletionLatch done;
+        explicit Job(size_t tile_total) : done(tile_total) {}
+
+        // Returns once no band is left to claim.
+        void run() {
+            for (size_t t = next++; t < tiles.size(); t = next++) {
+                const YoloV5DecodeTile &tile = tiles[t];
+                decode_yolov5_head(heads[tile.head], apply_sigmoid, output + tile.head_offset, score_sigmoid,
+                                   tile.y_begin, tile.y_end);
+                done.count_down();
+            }
+        }
+    };
+
+    size_t rows = 0;
+    for (const auto &head : heads) {
+        yolo_detail::check_harness_classes(head); // here rather than on a pool thread
+        rows += head.rows();
+    }
+    output.resize(rows * YOLOV5_ATTRIBUTES);
+
+    if (0 == tile_count) tile_count = 4 * (pool.size() + 1);
+    auto tiles = plan_yolov5_tiles(heads, tile_count);
+    auto job = std::make_shared<Job>(tiles.size());
+    job->heads = heads;
+    job->tiles = std::move(tiles);
+    job->apply_sigmoid = apply_sigmoid;
+    job->score_sigmoid = score_sigmoid;
+    job->output = output.data();
+
+    const size_t helpers = std::min(pool.size(), job->tiles.size() - std::min<size_t>(job->tiles.size(), 1));
+    for (size_t i = 0; i < helpers; ++i) {
+        pool.post([job] { job->run(); });
+    }
+    job->run();
+    job->done.wait();
+}
+
+#endif /* _YOLO_DECODE_HPP_ */
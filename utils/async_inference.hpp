@@ -3,6 +3,7 @@
 
 #include "hailo/hailort.hpp"
 #include "utils.hpp"
+#include "worker_pool.hpp"
 #include <vector>  
 
 #include <iostream>
@@ -15,6 +16,9 @@
 #include <condition_variable>
 #include <queue>
 #include <atomic>
+#include <memory>
+#include <functional>
+#include <chrono>
 
 using namespace hailort;
 
@@ -86,23 +90,94 @@ public:
 };
 
 
+// One set of device bindings together with the input/output memory bound to it.
+// A set belongs to exactly one in-flight job at a time, so no two jobs ever alias buffers.
+struct BindingSet {
+    hailort::ConfiguredInferModel::Bindings bindings;
+    std::vector<std::shared_ptr<uint8_t>> output_buffers;
+    std::vector<std::pair<uint8_t*, hailo_vstream_info_t>> output_data_and_infos;
+    std::shared_ptr<const void> input_guard; // owner of the caller memory bound as input, if any
+};
+
+// Fixed ring of binding sets. acquire() blocks until a set is free and returns a lease;
+// the set goes back to the ring when the last copy of the lease is dropped.
+class BindingSetPool : public std::enable_shared_from_this<BindingSetPool> {
+private:
+    std::vector<BindingSet> m_sets;
+    std::vector<size_t> m_free;
+    std::mutex m_mutex;
+    std::condition_variable m_cond_free;
+
+    void release(size_t index);
+
+public:
+    BindingSetPool() = default;
+    BindingSetPool(const BindingSetPool&) = delete;
+    BindingSetPool& operator=(const BindingSetPool&) = delete;
+
+    void add(BindingSet binding_set);
+    std::shared_ptr<BindingSet> acquire();
+    size_t size();
+    size_t in_flight();
+    void wait_all_released();
+};
+
+// The model configured for one device batch size, with its own ring of binding sets.
+struct BatchConfiguration {
+    uint16_t batch_size = 1;
+    hailort::ConfiguredInferModel configured_infer_model;
+    std::shared_ptr<BindingSetPool> binding_pool;
+};
+
+struct BatchSwitchStats {
+    size_t switch_count = 0;
+    double last_drain_ms = 0.0;       // waiting for the previous configuration's jobs
+    double last_first_frame_ms = 0.0; // first job on the new configuration, incl. the scheduler switch
+    double total_ms = 0.0;
+};
+
+// How a frame is pushed into a device that is not ready. Waiting for a free slot is the backpressure;
+// a frame that still can't be started after max_attempts is completed with an error instead.
+struct SubmitPolicy {
+    std::chrono::milliseconds ready_timeout{1000}; // per wait_for_async_ready attempt
+    size_t max_attempts = 3;
+    std::chrono::milliseconds retry_backoff{10};   // doubled after every failed attempt
+};
+
+struct SubmissionStats {
+    size_t submitted = 0;
+    size_t completed = 0;   // finished with HAILO_SUCCESS
+    size_t failed = 0;      // never started, or finished with an error status
+    size_t retries = 0;
+    size_t timeouts = 0;
+};
+
+
 class AsyncModelInfer {
     private:
         std::unique_ptr<hailort::VDevice> vdevice;
 
         std::shared_ptr<hailort::InferModel> infer_model;
-        hailort::ConfiguredInferModel configured_infer_model;
-        hailort::ConfiguredInferModel::Bindings bindings;
+        std::vector<BatchConfiguration> batch_configurations; // ascending batch size
+        size_t active_configuration = 0;
+        std::chrono::steady_clock::time_point switch_started;
+        bool switch_pending = false;
+        std::shared_ptr<std::mutex> switch_stats_mutex = std::make_shared<std::mutex>();
+        std::shared_ptr<BatchSwitchStats> switch_stats = std::make_shared<BatchSwitchStats>();
+        SubmitPolicy submit_policy;
+        std::shared_ptr<std::mutex> submission_stats_mutex = std::make_shared<std::mutex>();
+        std::shared_ptr<SubmissionStats> submission_stats = std::make_shared<SubmissionStats>();
 
-        std::vector<std::shared_ptr<std::vector<uint8_t>>> input_buffer_guards;
-        std::vector<std::shared_ptr<uint8_t>> output_buffer_guards;
-        
         std::map<std::string, hailo_vstream_info_t> output_vstream_info_by_name;
-        std::shared_ptr<uint8_t> output_data_holder;
-       
+
         std::shared_ptr<BoundedTSQueue<InferenceOutputItem>> output_data_queue;
 
     public:
+        // Per-job completion functor. It runs on the HailoRT completion thread, so it must either be
+        // short (e.g. copy 1000 scores into the caller's result slot) or post the item to a WorkerPool.
+        // The item keeps its binding set leased for as long as it (or a copy of it) is alive.
+        using FrameCallback = std::function<void(InferenceOutputItem &item)>;
+
         // Constructors
         AsyncModelInfer() = default; // Default constructor
         AsyncModelInfer(std::shared_ptr<hailort::InferModel> infer_model);
@@ -120,17 +195,51 @@ class AsyncModelInfer {
         const std::vector<hailort::InferModel::InferStream>& get_outputs();
         const std::shared_ptr<hailort::InferModel> get_infer_model();
         std::shared_ptr<BoundedTSQueue<InferenceOutputItem>> get_queue();
+        size_t get_binding_set_count();
+        size_t get_input_frame_size();
+        hailo_3d_image_shape_t get_input_shape();
+        // In the order of output_data_and_infos.
+        std::vector<hailo_vstream_info_t> get_output_vstream_infos();
+        uint16_t get_batch_size();
+        BatchSwitchStats get_batch_switch_stats();
+        SubmissionStats get_submission_stats();
+        void set_submit_policy(const SubmitPolicy &policy);
 
         // Functions
-        void PathAndResult(const std::string &hef_path);
-        void configure(std::shared_ptr<BoundedTSQueue<InferenceOutputItem>> output_data_queue);
+        // output_format: the type every output is converted to on the device side. HAILO_FORMAT_TYPE_AUTO
+        // keeps the HEF's native (quantized) outputs; the caller then dequantizes with the vstream
+        // quant info, and each frame moves a quarter of the float bytes over PCIe.
+        void PathAndResult(const std::string &hef_path,
+                           hailo_format_type_t output_format = HAILO_FORMAT_TYPE_FLOAT32);
+        // Configures the model once per entry of batch_sizes (a configuration the device can't fit is
+        // skipped) and starts on the smallest. binding_set_count = 0 sizes each ring from that
+        // configuration's async queue size.
+        void configure(std::shared_ptr<BoundedTSQueue<InferenceOutputItem>> output_data_queue,
+                       size_t binding_set_count = 0,
+                       const std::vector<uint16_t> &batch_sizes = {1, 8, 32});
+        // Picks the largest configured batch size that pending_frames can fill (batch 1 for
+        // SingleStream-style single queries, the biggest for offline runs). Switching waits for the
+        // jobs of the previous configuration; its cost is printed and kept in get_batch_switch_stats().
+        void select_batch_size(size_t pending_frames);
         void infer(std::shared_ptr<std::vector<uint8_t>> input_data, size_t frame_idx);
+        // Binds the caller's memory directly as the device input (no copy). The memory must stay valid
+        // until the job completes: either pass an owner in input_guard, which is held until then,
+        // or keep it alive yourself and call clear() before releasing it.
+        void infer(const uint8_t *input_data, size_t frame_idx, std::shared_ptr<const void> input_guard = nullptr);
+        // Same as above, but the finished frame goes to on_done instead of the results queue.
+        void infer(const uint8_t *input_data, size_t frame_idx, FrameCallback on_done,
+                   std::shared_ptr<const void> input_guard = nullptr);
         void crt();
+        // Opens a VDevice over one physical device only (ids as returned by scan_device_ids()).
+        void crt(const std::string &device_id);
+        static std::vector<std::string> scan_device_ids();
         //Helpers
-        void set_input_buffers(const std::shared_ptr<std::vector<uint8_t>> &input_data);
-        std::vector<std::pair<uint8_t*, hailo_vstream_info_t>> prepare_output_buffers();
-        void wait_and_run_async(size_t frame_idx,
-                                const std::vector<std::pair<uint8_t*, hailo_vstream_info_t>> &output_data_and_infos);
+        BindingSet create_binding_set(hailort::ConfiguredInferModel &configured_infer_model);
+        void set_input_buffers(BindingSet &binding_set, const uint8_t *input_data, std::shared_ptr<const void> input_guard);
+        // Every frame_idx passed in is completed exactly once, through on_done or the queue: on success
+        // with HAILO_SUCCESS, otherwise with item.status set to the error once the retries run out.
+        void wait_and_run_async(size_t frame_idx, std::shared_ptr<BindingSet> binding_set,
+                                FrameCallback on_done = nullptr);
         void clear();
         
 };
@@ -0,0 +1,122 @@
+#ifndef _DXRT_BACKEND_HPP_
+#define _DXRT_BACKEND_HPP_
+
+#include "dxrt/dxrt_api.h"
+#include "inference_backend.hpp"
+
+#include <deque>
+#include <iostream>
+#include <thread>
+
+// InferenceBackend adapter over dxrt::InferenceEngine::RunAsync/Wait.
+// A single waiter thread collects jobs in submission order and hands their outputs on.
+class DxrtBackend : public InferenceBackend {
+private:
+    struct PendingJob {
+        int request_id;
+        size_t frame_idx;
+        CompletionHandler on_complete;
+        std::shared_ptr<const void> input_guard;
+        std::shared_ptr<void> slot;
+    };
+
+    std::shared_ptr<dxrt::InferenceEngine> m_ie;
+    size_t m_input_frame_size;
+    // DX-RT recycles its output memory, so a slot stays taken until the frame's outputs are released.
+    std::shared_ptr<InFlightLimiter> m_limiter;
+
+    std::deque<PendingJob> m_pending;
+    std::mutex m_mutex;
+    std::condition_variable m_cond_pending;
+    bool m_stopped = false;
+    std::thread m_waiter;
+
+    void wait_loop() {
+        while (true) {
+            PendingJob job;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cond_pending.wait(lock, [this] { return !m_pending.empty() || m_stopped; });
+                if (m_pending.empty()) {
+                    return;
+                }
+                job = std::move(m_pending.front());
+                m_pending.pop_front();
+            }
+
+            InferenceCompletion completion;
+            completion.frame_idx = job.frame_idx;
+            try {
+                auto outputs = std::make_shared<std::vector<std::shared_ptr<dxrt::Tensor>>>(m_ie->Wait(job.request_id));
+                for (const auto &tensor : *outputs) {
+                    TensorView view;
+                    view.data = static_cast<const uint8_t*>(tensor->data());
+                    view.dtype = TensorDataType::FLOAT32;
+                    for (int64_t dim : tensor->shape()) {
+                        if (view.shape.rank < view.shape.dims.size()) view.shape.dims[view.shape.rank++] = dim;
+                    }
+                    view.size_bytes = view.shape.elements() * sizeof(float);
+                    completion.outputs.push_back(view);
+                }
+                // Outputs, input and slot all live exactly as long as the completion's guard.
+                auto input_guard = std::move(job.input_guard);
+                auto slot = std::move(job.slot);
+                completion.output_guard = std::shared_ptr<void>(nullptr,
+                    [outputs, input_guard, slot](void *) mutable { outputs.reset(); input_guard.reset(); slot.reset(); });
+            } catch (const std::exception &e) {
+                std::cerr << "DX-RT Wait failed for frame " << job.frame_idx << ": " << e.what() << std::endl;
+                completion.status = -1;
+                completion.outputs.clear();
+            }
+            job.on_complete(completion);
+        }
+    }
+
+public:
+    DxrtBackend(std::shared_ptr<dxrt::InferenceEngine> ie, size_t input_frame_size, size_t max_in_flight)
+        : m_ie(std::move(ie)),
+          m_input_frame_size(input_frame_size),
+          m_limiter(std::make_shared<InFlightLimiter>(max_in_flight))
+    {
+        m_waiter = std::thread(&DxrtBackend::wait_loop, this);
+    }
+    ~DxrtBackend() override {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopped = true;
+        }
+        m_cond_pending.notify_all();
+        m_waiter.join();
+    }
+
+    BackendCapabilities capabilities() const override {
+        BackendCapabilities capabilities;
+        capabilities.name = "DX-RT";
+        capabilities.max_in_flight = m_limiter->limit();
+        capabilities.input_frame_size = m_input_frame_size;
+        capabilities.zero_copy_input = true;
+        capabilities.completes_on_device_thread = false;
+        return capabilities;
+    }
+
+    void submit(InferenceRequest request, CompletionHandler on_complete) override {
+        PendingJob job;
+        job.slot = m_limiter->acquire();
+        job.frame_idx = request.frame_idx;
+        job.on_complete = std::move(on_complete);
+        job.input_guard = std::move(request.input_guard);
+        // DX-RT only reads from the input, the API just isn't const-qualified.
+        job.request_id = m_ie->RunAsync(const_cast<uint8_t*>(request.input));
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_pending.push_back(std::move(job));
+        }
+        m_cond_pending.notify_one();
+    }
+
+    void drain() override {
+        m_limiter->wait_idle();
+    }
+};
+
+#endif /* _DXRT_BACKEND_HPP_ */
@@ -0,0 +1,120 @@
+#ifndef _HAILO_BACKEND_HPP_
+#define _HAILO_BACKEND_HPP_
+
+#include "async_inference.hpp"
+#include "inference_backend.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+// InferenceBackend adapter over AsyncModelInfer. Inputs are bound in place and results are
+// delivered through the per-job completion functor, so neither side needs a queue.
+class HailoBackend : public InferenceBackend {
+private:
+    std::shared_ptr<AsyncModelInfer> m_model;
+    std::vector<std::string> m_output_names;
+    std::vector<TensorView> m_output_template; // shape/type of every output, data filled per frame
+
+    // Anything else (including an AUTO the configure step left unresolved) would be decoded with
+    // the wrong element size, so it is refused.
+    static TensorDataType to_tensor_data_type(hailo_format_type_t type, const std::string &output) {
+        switch (type) {
+            case HAILO_FORMAT_TYPE_UINT8:   return TensorDataType::UINT8;
+            case HAILO_FORMAT_TYPE_UINT16:  return TensorDataType::UINT16;
+            case HAILO_FORMAT_TYPE_FLOAT32: return TensorDataType::FLOAT32;
+            default:
+                throw std::runtime_error("HailoBackend: output " + output + " has unsupported format type " +
+                                         std::to_string(static_cast<int>(type)));
+        }
+    }
+
+public:
+    // model must already be configured (AsyncModelInfer::configure).
+    explicit HailoBackend(std::shared_ptr<AsyncModelInfer> model) : m_model(std::move(model)) {
+        // Same order as the binding sets' output_data_and_infos.
+        auto infer_model = m_model->get_infer_model();
+        m_output_names = infer_model->get_output_names();
+        for (size_t i = 0; i < m_output_names.size(); i++) {
+            auto output = infer_model->output(m_output_names[i]).expect("Failed to get output stream");
+            auto shape = output.shape();
+            TensorView view;
+            view.size_bytes = output.get_frame_size();
+            view.shape = TensorShape{1, shape.height, shape.width, shape.features};
+            view.dtype = to_tensor_data_type(output.format().type, m_output_names[i]);
+            auto quant_infos = output.get_quant_infos();
+            if (!quant_infos.empty()) {
+                view.quant.scale = quant_infos.front().qp_scale;
+                view.quant.zero_point = quant_infos.front().qp_zp;
+            }
+            view.name = m_output_names[i].c_str();
+            m_output_template.push_back(view);
+        }
+    }
+
+    BackendCapabilities capabilities() const override {
+        BackendCapabilities capabilities;
+        capabilities.name = "Hailo";
+        capabilities.max_in_flight = m_model->get_binding_set_count();
+        capabilities.input_frame_size = m_model->get_input_frame_size();
+        capabilities.zero_copy_input = true;
+        capabilities.completes_on_device_thread = true;
+        return capabilities;
+    }
+
+    void submit(InferenceRequest request, CompletionHandler on_complete) override {
+        m_model->infer(request.input, request.frame_idx,
+            [this, on_complete = std::move(on_complete)](InferenceOutputItem &item) {
+                InferenceCompletion completion;
+                completion.frame_idx = item.frame_idx;
+                completion.status = item.status;
+                if (completion.ok()) {
+                    completion.outputs = m_output_template;
+                    for (size_t i = 0; i < completion.outputs.size() && i < item.output_data_and_infos.size(); i++) {
+                        completion.outputs[i].data = item.output_data_and_infos[i].first;
+                    }
+                }
+                completion.output_guard = item.buffer_guard;
+                on_complete(completion);
+            },
+            std::move(request.input_guard));
+    }
+
+    void drain() override {
+        m_model->clear();
+    }
+
+    void hint_pending(size_t pending_frames) override {
+        m_model->select_batch_size(pending_frames);
+    }
+
+    std::shared_ptr<AsyncModelInfer> model() const { return m_model; }
+};
+
+// One configured HailoBackend per Hailo device found on the host (a single default VDevice if the
+// scan finds one device or fails). Combine them with combine_backends() to use every device.
+// output_format is passed to AsyncModelInfer::PathAndResult.
+inline std::vector<std::shared_ptr<InferenceBackend>> create_hailo_backends(const std::string &hef_path,
+                                                                            hailo_format_type_t output_format = HAILO_FORMAT_TYPE_FLOAT32)
+{
+    auto device_ids = AsyncModelInfer::scan_device_ids();
+    std::vector<std::shared_ptr<InferenceBackend>> backends;
+    for (size_t i = 0; i < std::max<size_t>(device_ids.size(), 1); i++) {
+        auto model = std::make_shared<AsyncModelInfer>();
+        if (device_ids.size() > 1) {
+            model->crt(device_ids[i]);
+        } else {
+            model->crt();
+        }
+        model->PathAndResult(hef_path, output_format);
+        model->configure(nullptr); // results are delivered through per-job callbacks
+        backends.push_back(std::make_shared<HailoBackend>(model));
+    }
+    if (backends.size() > 1) {
+        std::cout << "-I- Using " << backends.size() << " Hailo devices" << std::endl;
+    }
+    return backends;
+}
+
+#endif /* _HAILO_BACKEND_HPP_ */
@@ -0,0 +1,169 @@
+#ifndef _IMAGE_PREPROCESS_HPP_
+#define _IMAGE_PREPROCESS_HPP_
+
+#include "simd_math.hpp"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Decoded BGR image (e.g. cv::Mat data/cols/rows/step) to a planar CHW tensor in one pass: channel
+// swap, scaling to [0, 1], mean/std normalization and the HWC -> CHW transpose. The normalization
+// is folded into out = pixel * scale[c] + bias[c]. The NEON path deinterleaves 16 pixels per load;
+// other targets use the scalar loop.
+struct ChannelNormalization {
+    float mean[3] = {0.0f, 0.0f, 0.0f}; // in [0, 1] units, output channel order
+    float std[3] = {1.0f, 1.0f, 1.0f};
+
+    static ChannelNormalization imagenet() { return {{0.485f, 0.456f, 0.406f}, {0.229f, 0.224f, 0.225f}}; }
+    static ChannelNormalization unit() { return {}; } // pixel / 255 only
+};
+
+namespace preprocess_detail {
+
+struct Affine {
+    float scale[3];
+    float bias[3];
+    int source[3]; // interleaved channel that feeds output plane c
+
+    Affine(const ChannelNormalization &norm, bool to_rgb) {
+        for (int c = 0; c < 3; ++c) {
+            scale[c] = 1.0f / (255.0f * norm.std[c]);
+            bias[c] = -norm.mean[c] / norm.std[c];
+            source[c] = to_rgb ? 2 - c : c;
+        }
+    }
+};
+
+// IEEE half from float, round to nearest even; overflow goes to inf, NaN stays NaN.
+inline uint16_t float_to_half(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    const uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000u);
+    const uint32_t magnitude = bits & 0x7fffffffu;
+    if (magnitude >= 0x47800000u) { // >= 65536 (after rounding), inf or NaN
+        return sign | ((magnitude > 0x7f800000u) ? 0x7e00u : 0x7c00u);
+    }
+    if (magnitude < 0x38800000u) { // below the smallest normal half: subnormal in units of 2^-24
+        float f;
+        std::memcpy(&f, &magnitude, sizeof(f));
+        return sign | static_cast<uint16_t>(std::lrint(f * 16777216.0f));
+    }
+    const uint32_t rounded = magnitude + 0xfffu + ((magnitude >> 13) & 1u);
+    return sign | static_cast<uint16_t>((rounded - 0x38000000u) >> 13);
+}
+
+inline void store_value(float *out, float v) { *out = v; }
+inline void store_value(uint16_t *out, float v) { *out = float_to_half(v); }
+
+template <typename Out>
+inline void row_scalar(const uint8_t *src, int x_begin, int width, const Affine &affine, Out *const planes[3])
+{
+    for (int x = x_begin; x < width; ++x) {
+        const uint8_t *pixel = src + 3 * x;
+        for (int c = 0; c < 3; ++c) {
+            store_value(planes[c] + x, pixel[affine.source[c]] * affine.scale[c] + affine.bias[c]);
+        }
+    }
+}
+
+#if defined(SIMD_MATH_NEON)
+inline float32x4_t affine4(float32x4_t v, float32x4_t scale, float32x4_t bias)
+{
+#if defined(__aarch64__)
+    return vfmaq_f32(bias, v, scale);
+#else
+    return vmlaq_f32(bias, v, scale);
+#endif
+}
+
+// The 16 pixels of one channel as four float vectors, already normalized.
+inline void channel16(uint8x16_t values, float32x4_t scale, float32x4_t bias, float32x4_t out[4])
+{
+    const uint16x8_t lo = vmovl_u8(vget_low_u8(values));
+    const uint16x8_t hi = vmovl_u8(vget_high_u8(values));
+    out[0] = affine4(vcvtq_f32_u32(vmovl_u16(vget_low_u16(lo))), scale, bias);
+    out[1] = affine4(vcvtq_f32_u32(vmovl_u16(vget_high_u16(lo))), scale, bias);
+    out[2] = affine4(vcvtq_f32_u32(vmovl_u16(vget_low_u16(hi))), scale, bias);
+    out[3] = affine4(vcvtq_f32_u32(vmovl_u16(vget_high_u16(hi))), scale, bias);
+}
+
+inline void store16(float *out, const float32x4_t v[4])
+{
+    for (int k = 0; k < 4; ++k) vst1q_f32(out + 4 * k, v[k]);
+}
+
+inline void store16(uint16_t *out, const float32x4_t v[4])
+{
+#if defined(__aarch64__)
+    for (int k = 0; k < 4; ++k) vst1_u16(out + 4 * k, vreinterpret_u16_f16(vcvt_f16_f32(v[k])));
+#else
+    float lanes[16];
+    for (int k = 0; k < 4; ++k) vst1q_f32(lanes + 4 * k, v[k]);
+    for (int i = 0; i < 16; ++i) out[i] = float_to_half(lanes[i]);
+#endif
+}
+
+// Returns the first pixel left for the scalar tail.
+template <typename Out>
+inline int row_neon(const uint8_t *src, int width, const Affine &affine, Out *const planes[3])
+{
+    float32x4_t scale[3], bias[3];
+    for (int c = 0; c < 3; ++c) {
+        scale[c] = vdupq_n_f32(affine.scale[c]);
+        bias[c] = vdupq_n_f32(affine.bias[c]);
+    }
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const uint8x16x3_t pixels = vld3q_u8(src + 3 * x);
+        for (int c = 0; c < 3; ++c) {
+            float32x4_t values[4];
+            channel16(pixels.val[affine.source[c]], scale[c], bias[c], values);
+            store16(planes[c] + x, values);
+        }
+    }
+    return x;
+}
+#endif
+
+// out_row_stride / plane_stride are in elements; 0 means packed (width, width * height).
+template <typename Out>
+inline void bgr_to_chw(const uint8_t *bgr, int width, int height, size_t row_stride,
+                       const ChannelNormalization &norm, Out *out, bool to_rgb,
+                       size_t out_row_stride = 0, size_t plane_stride = 0)
+{
+    const Affine affine(norm, to_rgb);
+    if (0 == out_row_stride) out_row_stride = static_cast<size_t>(width);
+    if (0 == plane_stride) plane_stride = out_row_stride * height;
+    for (int y = 0; y < height; ++y) {
+        const uint8_t *src = bgr + y * row_stride;
+        Out *const planes[3] = {out + y * out_row_stride, out + plane_stride + y * out_row_stride,
+                                out + 2 * plane_stride + y * out_row_stride};
+        int x = 0;
+#if defined(SIMD_MATH_NEON)
+        x = row_neon(src, width, affine, planes);
+#endif
+        row_scalar(src, x, width, affine, planes);
+    }
+}
+
+} // namespace preprocess_detail
+
+// out holds 3 * width * height values (planes in RGB order when to_rgb, else BGR). row_stride is
+// in bytes, so padded rows and ROIs work without a copy.
+inline void bgr_to_chw(const uint8_t *bgr, int width, int height, size_t row_stride,
+                       const ChannelNormalization &norm, float *out, bool to_rgb = true)
+{
+    preprocess_detail::bgr_to_chw(bgr, width, height, row_stride, norm, out, to_rgb);
+}
+
+// Same, written as IEEE fp16 bit patterns (e.g. for an Ort::Float16_t input tensor).
+inline void bgr_to_chw_fp16(const uint8_t *bgr, int width, int height, size_t row_stride,
+                            const ChannelNormalization &norm, uint16_t *out, bool to_rgb = true)
+{
+    preprocess_detail::bgr_to_chw(bgr, width, height, row_stride, norm, out, to_rgb);
+}
+
+#endif /* _IMAGE_PREPROCESS_HPP_ */
@@ -0,0 +1,161 @@
+#ifndef _INFERENCE_BACKEND_HPP_
+#define _INFERENCE_BACKEND_HPP_
+
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// ─────────────────────────────────────────────────────────────────────────────
+// SDK-independent description of an asynchronous inference device.
+// Each vendor (HailoRT, DX-RT, ONNX Runtime, mock) provides a thin adapter and
+// AsyncPipeline drives all of them the same way.
+// ─────────────────────────────────────────────────────────────────────────────
+
+enum class TensorDataType {
+    UINT8,
+    UINT16,
+    INT8,
+    FLOAT32
+};
+
+inline size_t tensor_data_type_size(TensorDataType type)
+{
+    switch (type) {
+        case TensorDataType::UINT8:   return 1;
+        case TensorDataType::INT8:    return 1;
+        case TensorDataType::UINT16:  return 2;
+        case TensorDataType::FLOAT32: return 4;
+    }
+    return 0;
+}
+
+// Up to 4 dimensions as reported by the backend (e.g. {1, 80, 80, 255} for an NHWC YOLO head).
+struct TensorShape {
+    std::array<int64_t, 4> dims{};
+    size_t rank = 0;
+
+    TensorShape() = default;
+    TensorShape(std::initializer_list<int64_t> values) {
+        for (int64_t value : values) {
+            if (rank < dims.size()) dims[rank++] = value;
+        }
+    }
+    int64_t operator[](size_t i) const { return dims[i]; }
+    size_t elements() const {
+        size_t count = (rank > 0) ? 1 : 0;
+        for (size_t i = 0; i < rank; i++) count *= static_cast<size_t>(dims[i]);
+        return count;
+    }
+};
+
+// Affine quantization: real = (quantized - zero_point) * scale.
+struct QuantParams {
+    float scale = 1.0f;
+    float zero_point = 0.0f;
+};
+
+// Non-owning view of one output tensor, valid while the completion's output_guard is alive.
+struct TensorView {
+    const uint8_t *data = nullptr;
+    size_t size_bytes = 0;
+    TensorShape shape;
+    TensorDataType dtype = TensorDataType::FLOAT32;
+    QuantParams quant;
+    const char *name = ""; // owned by the backend
+};
+
+struct InferenceRequest {
+    size_t frame_idx = 0;
+    const uint8_t *input = nullptr;
+    size_t input_size = 0;
+    std::shared_ptr<const void> input_guard; // optional owner of input, held until the frame completes
+};
+
+struct InferenceCompletion {
+    size_t frame_idx = 0;
+    int status = 0; // 0 on success, backend specific error code otherwise (outputs are empty then)
+    std::vector<TensorView> outputs;
+    std::shared_ptr<void> output_guard; // backend buffers are recycled once every copy of this is dropped
+
+    bool ok() const { return 0 == status; }
+};
+
+using CompletionHandler = std::function<void(InferenceCompletion &completion)>;
+
+struct BackendCapabilities {
+    std::string name;
+    size_t max_in_flight = 1;       // frames the backend accepts before submit() blocks
+    size_t input_frame_size = 0;    // bytes per input frame, used for raw pointer inputs
+    bool zero_copy_input = false;   // input memory is bound directly and must outlive the frame
+    bool completes_on_device_thread = false; // handlers run on a thread that also services the device
+};
+
+class InferenceBackend {
+public:
+    virtual ~InferenceBackend() = default;
+
+    virtual BackendCapabilities capabilities() const = 0;
+
+    // Queues one frame. Blocks while the backend already holds max_in_flight frames (backpressure).
+    // on_complete is called exactly once for every submitted frame, success or not.
+    virtual void submit(InferenceRequest request, CompletionHandler on_complete) = 0;
+
+    // Tells the backend how many frames are about to be submitted, so it can e.g. pick a device
+    // batch size (1 for single queries, large for offline runs). Called before the first submit().
+    virtual void hint_pending(size_t pending_frames) { (void)pending_frames; }
+
+    // Blocks until every submitted frame has completed and its output_guard has been released.
+    virtual void drain() = 0;
+};
+
+// Counting limiter used by adapters to bound in-flight frames. acquire() returns a lease;
+// the slot is free again once every copy of the lease is dropped.
+class InFlightLimiter : public std::enable_shared_from_this<InFlightLimiter> {
+private:
+    size_t m_limit;
+    size_t m_in_flight = 0;
+    std::mutex m_mutex;
+    std::condition_variable m_cond_changed;
+
+    void release() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_in_flight--;
+        }
+        m_cond_changed.notify_all();
+    }
+
+public:
+    explicit InFlightLimiter(size_t limit) : m_limit(limit > 0 ? limit : 1) {}
+
+    InFlightLimiter(const InFlightLimiter&) = delete;
+    InFlightLimiter& operator=(const InFlightLimiter&) = delete;
+
+    std::shared_ptr<void> acquire() {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cond_changed.wait(lock, [this] { return m_in_flight < m_limit; });
+            m_in_flight++;
+        }
+        auto self = shared_from_this();
+        return std::shared_ptr<void>(nullptr, [self](void *) { self->release(); });
+    }
+    void wait_idle() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cond_changed.wait(lock, [this] { return 0 == m_in_flight; });
+    }
+    size_t in_flight() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_in_flight;
+    }
+    size_t limit() const { return m_limit; }
+};
+
+#endif /* _INFERENCE_BACKEND_HPP_ */
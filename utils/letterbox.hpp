@@ -0,0 +1,311 @@
+#ifndef _LETTERBOX_HPP_
+#define _LETTERBOX_HPP_
+
+#include "label_type.h"
+#include "simd_math.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Aspect-preserving resize into a fixed network input, padded with a constant border (YOLO-style
+// letterbox), with the BGR -> RGB swap folded in. The bilinear source offsets and weights depend
+// only on the source resolution, so they are computed once per resolution and cached. Each output
+// row is one horizontal pass over two source rows (kept for the next row when they are shared)
+// and one vertical blend, which runs 8 bytes at a time on NEON/SSE2.
+
+// Affine box mapping between two pixel frames: x' = x * scale_x + offset_x, sizes scale only.
+struct BoxMapping {
+    float scale_x = 1.0f;
+    float scale_y = 1.0f;
+    float offset_x = 0.0f;
+    float offset_y = 0.0f;
+
+    bool identity() const { return 1.0f == scale_x && 1.0f == scale_y && 0.0f == offset_x && 0.0f == offset_y; }
+
+    void apply(Coco17DetectionResult &detection) const {
+        detection.top_left_x = detection.top_left_x * scale_x + offset_x;
+        detection.top_left_y = detection.top_left_y * scale_y + offset_y;
+        detection.width *= scale_x;
+        detection.height *= scale_y;
+    }
+    void apply(std::vector<Coco17DetectionResult> &detections) const {
+        if (identity()) return;
+        for (auto &detection : detections) apply(detection);
+    }
+};
+
+// Where the source image ended up in the network input: x_network = x_source * scale + pad_x.
+struct LetterboxTransform {
+    float scale = 1.0f;
+    float pad_x = 0.0f;
+    float pad_y = 0.0f;
+    int source_w = 0;
+    int source_h = 0;
+
+    bool identity() const { return 1.0f == scale && 0.0f == pad_x && 0.0f == pad_y; }
+
+    // Network-input boxes into source pixels.
+    BoxMapping to_source() const { return to_resized(source_w, source_h); }
+
+    // Network-input boxes into the frame of a plain (aspect-ignoring) resize of the source to
+    // width x height, which is what a caller expecting stretched inputs scores against.
+    BoxMapping to_resized(int width, int height) const {
+        BoxMapping mapping;
+        if (identity() || source_w <= 0 || source_h <= 0) return mapping;
+        mapping.scale_x = static_cast<float>(width) / (source_w * scale);
+        mapping.scale_y = static_cast<float>(height) / (source_h * scale);
+        mapping.offset_x = -pad_x * mapping.scale_x;
+        mapping.offset_y = -pad_y * mapping.scale_y;
+        return mapping;
+    }
+};
+
+// Letterbox transforms of preprocessed frames, keyed by a hash of the frame's bytes rather than by
+// call order, so the harness may convert from several threads, copy the frames, and run, shuffle
+// or repeat queries in any order. Converting an image again replaces its entry, so there is one
+// entry per distinct frame. A frame that was never recorded maps to the identity.
+class LetterboxTransformTable {
+private:
+    mutable std::mutex m_mutex;
+    std::unordered_map<uint64_t, LetterboxTransform> m_transforms;
+
+public:
+    // 8 bytes per step, with a final avalanche so the low bits used by the map depend on them all.
+    static uint64_t frame_hash(const uint8_t *frame, size_t size) {
+        uint64_t hash = 0x9e3779b97f4a7c15ull ^ size;
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8) {
+            uint64_t word;
+            std::memcpy(&word, frame + i, sizeof(word));
+            hash = (hash ^ word) * 0x100000001b3ull;
+        }
+        for (; i < size; ++i) hash = (hash ^ frame[i]) * 0x100000001b3ull;
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdull;
+        hash ^= hash >> 33;
+        return hash;
+    }
+
+    void record(const uint8_t *frame, size_t size, const LetterboxTransform &transform) {
+        const uint64_t hash = frame_hash(frame, size);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_transforms[hash] = transform;
+    }
+
+    // Hashes the frame outside the lock, so decode threads can look up concurrently.
+    LetterboxTransform find(const uint8_t *frame, size_t size) const {
+        if (!frame) return LetterboxTransform();
+        const uint64_t hash = frame_hash(frame, size);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_transforms.find(hash);
+        return (it != m_transforms.end()) ? it->second : LetterboxTransform();
+    }
+};
+
+class LetterboxPreprocessor {
+private:
+    static constexpr int WEIGHT_BITS = 7; // bilinear weights in 1/128: 255 * 128 still fits int16
+    static constexpr int WEIGHT_ONE = 1 << WEIGHT_BITS;
+
+    struct Maps {
+        LetterboxTransform transform;
+        int content_w = 0;
+        int content_h = 0;
+        int pad_left = 0;
+        int pad_top = 0;
+        std::vector<int> x0, x1;         // byte offsets of the two source pixels per content column
+        std::vector<int16_t> wx;         // weight of x1
+        std::vector<int> y0, y1;         // source rows per content row
+        std::vector<int16_t> wy;         // weight of y1
+    };
+
+    int m_width;
+    int m_height;
+    uint8_t m_pad_value;
+    bool m_to_rgb;
+    struct CachedMaps {
+        std::shared_ptr<const Maps> maps;
+        uint64_t last_used = 0;
+    };
+
+    mutable std::mutex m_mutex;
+    mutable std::map<std::pair<int, int>, CachedMaps> m_maps;
+    mutable uint64_t m_lookups = 0;
+
+    // COCO has hundreds of source sizes but a few dozen cover most images; the least recently
+    // used entry makes room for a new size.
+    static constexpr size_t MAX_CACHED_RESOLUTIONS = 64;
+
+    std::shared_ptr<const Maps> build_maps(int src_w, int src_h) const {
+        auto maps = std::make_shared<Maps>();
+        const float scale = std::min(static_cast<float>(m_width) / src_w, static_cast<float>(m_height) / src_h);
+        maps->content_w = std::min(m_width, std::max(1, static_cast<int>(std::lround(src_w * scale))));
+        maps->content_h = std::min(m_height, std::max(1, static_cast<int>(std::lround(src_h * scale))));
+        maps->pad_left = (m_width - maps->content_w) / 2;
+        maps->pad_top = (m_height - maps->content_h) / 2;
+        maps->transform.scale = scale;
+        maps->transform.pad_x = static_cast<float>(maps->pad_left);
+        maps->transform.pad_y = static_cast<float>(maps->pad_top);
+        maps->transform.source_w = src_w;
+        maps->transform.source_h = src_h;
+
+        // Same sampling as cv::resize INTER_LINEAR: centre-aligned, clamped at the border.
+        auto axis = [scale](int count, int src_size, std::vector<int> &i0, std::vector<int> &i1, std::vector<int16_t> &w, int step) {
+            i0.resize(count);
+            i1.resize(count);
+            w.resize(count);
+            for (int d = 0; d < count; ++d) {
+                float s = (d + 0.5f) / scale - 0.5f;
+                s = std::min(std::max(s, 0.0f), static_cast<float>(src_size - 1));
+                int s0 = std::min(static_cast<int>(s), src_size - 1);
+                int s1 = std::min(s0 + 1, src_size - 1);
+                i0[d] = s0 * step;
+                i1[d] = s1 * step;
+                w[d] = static_cast<int16_t>(std::lround((s - s0) * WEIGHT_ONE));
+            }
+        };
+        axis(maps->content_w, src_w, maps->x0, maps->x1, maps->wx, 3);
+        axis(maps->content_h, src_h, maps->y0, maps->y1, maps->wy, 1);
+        return maps;
+    }
+
+    std::shared_ptr<const Maps> maps_for(int src_w, int src_h) const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_maps.find({src_w, src_h});
+        if (it == m_maps.end()) {
+            if (m_maps.size() >= MAX_CACHED_RESOLUTIONS) {
+                m_maps.erase(std::min_element(m_maps.begin(), m_maps.end(), [](const auto &a, const auto &b) {
+                    return a.second.last_used < b.second.last_used;
+                }));
+            }
+            it = m_maps.emplace(std::make_pair(src_w, src_h), CachedMaps{build_maps(src_w, src_h), 0}).first;
+        }
+        it->second.last_used = ++m_lookups;
+        return it->second.maps;
+    }
+
+    // Two source pixels per output pixel, channels swapped, in 1/128 units.
+    void horizontal(const uint8_t *src, const Maps &maps, int16_t *row) const {
+        const int r = m_to_rgb ? 2 : 0, b = m_to_rgb ? 0 : 2;
+        for (int x = 0; x < maps.content_w; ++x, row += 3) {
+            const uint8_t *p0 = src + maps.x0[x];
+            const uint8_t *p1 = src + maps.x1[x];
+            const int w1 = maps.wx[x], w0 = WEIGHT_ONE - w1;
+            row[0] = static_cast<int16_t>(p0[r] * w0 + p1[r] * w1);
+            row[1] = static_cast<int16_t>(p0[1] * w0 + p1[1] * w1);
+            row[2] = static_cast<int16_t>(p0[b] * w0 + p1[b] * w1);
+        }
+    }
+
+    // out = round((a * (128 - w) + b * w) / 128^2)
+    static void vertical(const int16_t *a, const int16_t *b, int w1, size_t count, uint8_t *out) {
+        const int w0 = WEIGHT_ONE - w1;
+        size_t i = 0;
+#if defined(SIMD_MATH_NEON)
+        const uint16_t uw0 = static_cast<uint16_t>(w0), uw1 = static_cast<uint16_t>(w1);
+        for (; i + 8 <= count; i += 8) {
+            const uint16x8_t va = vreinterpretq_u16_s16(vld1q_s16(a + i));
+            const uint16x8_t vb = vreinterpretq_u16_s16(vld1q_s16(b + i));
+            uint32x4_t lo = vmlal_n_u16(vmull_n_u16(vget_low_u16(va), uw0), vget_low_u16(vb), uw1);
+            uint32x4_t hi = vmlal_n_u16(vmull_n_u16(vget_high_u16(va), uw0), vget_high_u16(vb), uw1);
+            const uint16x8_t sum = vcombine_u16(vrshrn_n_u32(lo, 2 * WEIGHT_BITS), vrshrn_n_u32(hi, 2 * WEIGHT_BITS));
+            vst1_u8(out + i, vqmovn_u16(sum));
+        }
+#elif defined(SIMD_MATH_SSE2)
+        const __m128i weights = _mm_set1_epi32((w1 << 16) | w0);
+        const __m128i round = _mm_set1_epi32(1 << (2 * WEIGHT_BITS - 1));
+        for (; i + 8 <= count; i += 8) {
+            const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+            const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+            __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi16(va, vb), weights);
+            __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi16(va, vb), weights);
+            lo = _mm_srai_epi32(_mm_add_epi32(lo, round), 2 * WEIGHT_BITS);
+            hi = _mm_srai_epi32(_mm_add_epi32(hi, round), 2 * WEIGHT_BITS);
+            const __m128i packed = _mm_packs_epi32(lo, hi);
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(out + i), _mm_packus_epi16(packed, packed));
+        }
+#endif
+        for (; i < count; ++i) {
+            out[i] = static_cast<uint8_t>((a[i] * w0 + b[i] * w1 + (1 << (2 * WEIGHT_BITS - 1))) >> (2 * WEIGHT_BITS));
+        }
+    }
+
+public:
+    LetterboxPreprocessor(int width, int height, uint8_t pad_value = 114, bool to_rgb = true)
+        : m_width(width), m_height(height), m_pad_value(pad_value), m_to_rgb(to_rgb) {}
+
+    LetterboxPreprocessor(const LetterboxPreprocessor &) = delete;
+    LetterboxPreprocessor &operator=(const LetterboxPreprocessor &) = delete;
+
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+    size_t frame_size() const { return static_cast<size_t>(m_width) * m_height * 3; }
+
+    LetterboxTransform transform_for(int src_w, int src_h) const { return maps_for(src_w, src_h)->transform; }
+
+    // bgr: src_w x src_h pixels, row_stride bytes apart. out: frame_size() bytes of interleaved
+    // (RGB unless to_rgb is false) pixels. Safe to call from several threads.
+    LetterboxTransform run(const uint8_t *bgr, int src_w, int src_h, size_t row_stride, uint8_t *out) const {
+        const size_t out_stride = static_cast<size_t>(m_width) * 3;
+        if (src_w == m_width && src_h == m_height) {
+            const int r = m_to_rgb ? 2 : 0, b = m_to_rgb ? 0 : 2;
+            for (int y = 0; y < src_h; ++y) {
+                const uint8_t *src = bgr + y * row_stride;
+                uint8_t *dst = out + y * out_stride;
+                for (int x = 0; x < src_w; ++x, src += 3, dst += 3) {
+                    dst[0] = src[r];
+                    dst[1] = src[1];
+                    dst[2] = src[b];
+                }
+            }
+            return LetterboxTransform();
+        }
+
+        std::shared_ptr<const Maps> maps = maps_for(src_w, src_h);
+        const size_t content_bytes = static_cast<size_t>(maps->content_w) * 3;
+        const size_t left_bytes = static_cast<size_t>(maps->pad_left) * 3;
+
+        thread_local std::vector<int16_t> rows[2];
+        rows[0].resize(content_bytes);
+        rows[1].resize(content_bytes);
+        int held[2] = {-1, -1}; // source row each buffer holds
+
+        for (int y = 0; y < m_height; ++y) {
+            uint8_t *dst = out + y * out_stride;
+            const int cy = y - maps->pad_top;
+            if (cy < 0 || cy >= maps->content_h) {
+                std::memset(dst, m_pad_value, out_stride);
+                continue;
+            }
+            const int s0 = maps->y0[cy], s1 = maps->y1[cy];
+            if (held[0] != s0) {
+                if (held[1] == s0) {
+                    std::swap(rows[0], rows[1]);
+                    std::swap(held[0], held[1]);
+                } else {
+                    horizontal(bgr + s0 * row_stride, *maps, rows[0].data());
+                    held[0] = s0;
+                }
+            }
+            if (held[1] != s1) {
+                horizontal(bgr + s1 * row_stride, *maps, rows[1].data());
+                held[1] = s1;
+            }
+            std::memset(dst, m_pad_value, left_bytes);
+            vertical(rows[0].data(), rows[1].data(), maps->wy[cy], content_bytes, dst + left_bytes);
+            std::memset(dst + left_bytes + content_bytes, m_pad_value, out_stride - left_bytes - content_bytes);
+        }
+        return maps->transform;
+    }
+};
+
+#endif /* _LETTERBOX_HPP_ */
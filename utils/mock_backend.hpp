@@ -0,0 +1,290 @@
+#ifndef _MOCK_BACKEND_HPP_
+#define _MOCK_BACKEND_HPP_
+
+#include "inference_backend.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <random>
+#include <string>
+#include <thread>
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Simulated accelerator for exercising the CPU side of the pipeline without a
+// Hailo-8 or DeepX M1 attached. It follows run_async/RunAsync semantics:
+// submit() blocks while the device queue is full, engine_count engines serve
+// frames in FIFO order with a configurable service time, completions arrive on
+// the engine threads, and output buffers come from a ring that is recycled
+// only after the completion's output_guard is dropped.
+// ─────────────────────────────────────────────────────────────────────────────
+
+enum class MockJitter {
+    NONE,
+    UNIFORM,     // service_time ± jitter
+    NORMAL,      // stddev = jitter
+    EXPONENTIAL  // extra delay with mean = jitter (long tail)
+};
+
+struct MockOutputSpec {
+    std::string name;
+    TensorShape shape;
+    TensorDataType dtype = TensorDataType::FLOAT32;
+};
+
+struct MockBackendConfig {
+    std::string name = "Mock";
+    std::chrono::microseconds service_time{1000}; // per frame, per engine
+    MockJitter jitter = MockJitter::NONE;
+    std::chrono::microseconds jitter_amount{0};
+    size_t engine_count = 1;        // frames processed in parallel
+    size_t device_queue_size = 4;   // frames accepted but not started yet
+    size_t output_buffer_sets = 0;  // 0 = twice (device_queue_size + engine_count)
+    size_t input_frame_size = 0;
+    std::vector<MockOutputSpec> outputs;
+    uint32_t seed = 1;
+
+    // Hailo YOLOv5 640x640: three NHWC heads with 3 anchors x 85 channels.
+    static MockBackendConfig yolov5_640() {
+        MockBackendConfig config;
+        config.name = "Mock YOLOv5 640";
+        config.input_frame_size = 640 * 640 * 3;
+        config.outputs = {
+            {"yolov5/conv_p3", TensorShape{1, 80, 80, 255}, TensorDataType::FLOAT32},
+            {"yolov5/conv_p4", TensorShape{1, 40, 40, 255}, TensorDataType::FLOAT32},
+            {"yolov5/conv_p5", TensorShape{1, 20, 20, 255}, TensorDataType::FLOAT32},
+        };
+        return config;
+    }
+
+    // ImageNet classifier: 224x224 RGB in, 1000 logits out.
+    static MockBackendConfig classification_1000() {
+        MockBackendConfig config;
+        config.name = "Mock Classification";
+        config.input_frame_size = 224 * 224 * 3;
+        config.outputs = {
+            {"classifier/logits", TensorShape{1, 1000}, TensorDataType::FLOAT32},
+        };
+        return config;
+    }
+};
+
+struct MockDeviceStats {
+    size_t frames = 0;
+    std::chrono::nanoseconds busy_time{0}; // summed over engines
+    size_t engine_count = 1;
+
+    // Fraction of the engines' capacity that was spent serving frames over wall_time.
+    double utilization(std::chrono::nanoseconds wall_time) const {
+        if (wall_time.count() <= 0 || 0 == engine_count) return 0.0;
+        return static_cast<double>(busy_time.count()) / (static_cast<double>(wall_time.count()) * engine_count);
+    }
+};
+
+class MockBackend : public InferenceBackend {
+private:
+    struct Job {
+        InferenceRequest request;
+        CompletionHandler on_complete;
+        std::shared_ptr<void> device_slot;
+    };
+
+    MockBackendConfig m_config;
+    std::shared_ptr<InFlightLimiter> m_device_slots; // queued + running frames
+    std::shared_ptr<InFlightLimiter> m_output_slots; // frames whose outputs are still held
+
+    // Output buffer ring, filled once with synthetic data.
+    std::vector<std::vector<std::vector<uint8_t>>> m_output_sets;
+    std::vector<size_t> m_free_sets;
+    std::vector<TensorView> m_output_template;
+
+    std::deque<Job> m_queue;
+    std::mutex m_mutex;
+    std::condition_variable m_cond_queue;
+    std::condition_variable m_cond_set_free;
+    bool m_stopped = false;
+    std::vector<std::thread> m_engines;
+
+    std::mutex m_stats_mutex;
+    MockDeviceStats m_stats;
+
+    static void fill_synthetic(std::vector<uint8_t> &buffer, TensorDataType dtype, std::mt19937 &rng) {
+        if (TensorDataType::FLOAT32 == dtype) {
+            // Mostly-low scores in [0, 0.1) like a sigmoid head on background.
+            std::uniform_real_distribution<float> dist(0.0f, 0.1f);
+            float *values = reinterpret_cast<float*>(buffer.data());
+            for (size_t i = 0; i < buffer.size() / sizeof(float); i++) values[i] = dist(rng);
+        } else {
+            std::uniform_int_distribution<int> dist(0, 255);
+            for (auto &byte : buffer) byte = static_cast<uint8_t>(dist(rng));
+        }
+    }
+
+    std::chrono::nanoseconds draw_service_time(std::mt19937 &rng) const {
+        using namespace std::chrono;
+        double base = static_cast<double>(duration_cast<nanoseconds>(m_config.service_time).count());
+        double jitter = static_cast<double>(duration_cast<nanoseconds>(m_config.jitter_amount).count());
+        double value = base;
+        switch (m_config.jitter) {
+            case MockJitter::NONE:
+                break;
+            case MockJitter::UNIFORM:
+                value += std::uniform_real_distribution<double>(-jitter, jitter)(rng);
+                break;
+            case MockJitter::NORMAL:
+                if (jitter > 0.0) value += std::normal_distribution<double>(0.0, jitter)(rng);
+                break;
+            case MockJitter::EXPONENTIAL:
+                if (jitter > 0.0) value += std::exponential_distribution<double>(1.0 / jitter)(rng);
+                break;
+        }
+        return nanoseconds(static_cast<int64_t>(std::max(0.0, value)));
+    }
+
+    size_t acquire_output_set() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cond_set_free.wait(lock, [this] { return !m_free_sets.empty(); });
+        size_t index = m_free_sets.back();
+        m_free_sets.pop_back();
+        return index;
+    }
+
+    void release_output_set(size_t index) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_free_sets.push_back(index);
+        }
+        m_cond_set_free.notify_one();
+    }
+
+    void engine_loop(size_t engine_idx) {
+        std::mt19937 rng(m_config.seed + static_cast<uint32_t>(engine_idx));
+        while (true) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cond_queue.wait(lock, [this] { return !m_queue.empty() || m_stopped; });
+                if (m_queue.empty()) {
+                    return;
+                }
+                job = std::move(m_queue.front());
+                m_queue.pop_front();
+            }
+
+            // Like a real device, an engine cannot start without somewhere to write its outputs.
+            size_t set_index = acquire_output_set();
+            auto start = std::chrono::steady_clock::now();
+            std::this_thread::sleep_until(start + draw_service_time(rng));
+            auto busy = std::chrono::steady_clock::now() - start;
+            {
+                std::lock_guard<std::mutex> lock(m_stats_mutex);
+                m_stats.frames++;
+                m_stats.busy_time += std::chrono::duration_cast<std::chrono::nanoseconds>(busy);
+            }
+
+            InferenceCompletion completion;
+            completion.frame_idx = job.request.frame_idx;
+            completion.outputs = m_output_template;
+            for (size_t i = 0; i < completion.outputs.size(); i++) {
+                completion.outputs[i].data = m_output_sets[set_index][i].data();
+            }
+            auto output_slot = m_output_slots->acquire();
+            auto input_guard = std::move(job.request.input_guard);
+            completion.output_guard = std::shared_ptr<void>(nullptr,
+                [this, set_index, output_slot, input_guard](void *) mutable {
+                    input_guard.reset();
+                    release_output_set(set_index);
+                    output_slot.reset();
+                });
+            job.device_slot.reset(); // the frame left the device queue
+            job.on_complete(completion);
+        }
+    }
+
+public:
+    explicit MockBackend(MockBackendConfig config) : m_config(std::move(config)) {
+        if (0 == m_config.engine_count) m_config.engine_count = 1;
+        size_t device_capacity = m_config.device_queue_size + m_config.engine_count;
+        size_t set_count = m_config.output_buffer_sets ? m_config.output_buffer_sets : 2 * device_capacity;
+        m_device_slots = std::make_shared<InFlightLimiter>(device_capacity);
+        m_output_slots = std::make_shared<InFlightLimiter>(set_count);
+        m_stats.engine_count = m_config.engine_count;
+
+        for (const auto &spec : m_config.outputs) {
+            TensorView view;
+            view.shape = spec.shape;
+            view.dtype = spec.dtype;
+            view.size_bytes = spec.shape.elements() * tensor_data_type_size(spec.dtype);
+            view.name = spec.name.c_str();
+            m_output_template.push_back(view);
+        }
+        std::mt19937 rng(m_config.seed);
+        m_output_sets.resize(set_count);
+        for (size_t s = 0; s < set_count; s++) {
+            for (const auto &view : m_output_template) {
+                m_output_sets[s].emplace_back(view.size_bytes);
+                fill_synthetic(m_output_sets[s].back(), view.dtype, rng);
+            }
+            m_free_sets.push_back(s);
+        }
+
+        for (size_t i = 0; i < m_config.engine_count; i++) {
+            m_engines.emplace_back(&MockBackend::engine_loop, this, i);
+        }
+    }
+
+    ~MockBackend() override {
+        drain();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopped = true;
+        }
+        m_cond_queue.notify_all();
+        for (auto &engine : m_engines) {
+            engine.join();
+        }
+    }
+
+    MockBackend(const MockBackend&) = delete;
+    MockBackend& operator=(const MockBackend&) = delete;
+
+    BackendCapabilities capabilities() const override {
+        BackendCapabilities capabilities;
+        capabilities.name = m_config.name;
+        capabilities.max_in_flight = m_device_slots->limit();
+        capabilities.input_frame_size = m_config.input_frame_size;
+        capabilities.zero_copy_input = true;
+        capabilities.completes_on_device_thread = true;
+        return capabilities;
+    }
+
+    void submit(InferenceRequest request, CompletionHandler on_complete) override {
+        Job job;
+        job.device_slot = m_device_slots->acquire(); // blocks like wait_for_async_ready()
+        job.request = std::move(request);
+        job.on_complete = std::move(on_complete);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_queue.push_back(std::move(job));
+        }
+        m_cond_queue.notify_one();
+    }
+
+    void drain() override {
+        m_device_slots->wait_idle();
+        m_output_slots->wait_idle();
+    }
+
+    MockDeviceStats stats() {
+        std::lock_guard<std::mutex> lock(m_stats_mutex);
+        return m_stats;
+    }
+
+    void reset_stats() {
+        std::lock_guard<std::mutex> lock(m_stats_mutex);
+        m_stats.frames = 0;
+        m_stats.busy_time = std::chrono::nanoseconds(0);
+    }
+};
+
+#endif /* _MOCK_BACKEND_HPP_ */
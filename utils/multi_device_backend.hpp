@@ -0,0 +1,284 @@
+#ifndef _MULTI_DEVICE_BACKEND_HPP_
+#define _MULTI_DEVICE_BACKEND_HPP_
+
+#include "inference_backend.hpp"
+
+#include <chrono>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+struct DeviceUtilization {
+    std::string name;
+    size_t frames = 0;
+    size_t stolen_frames = 0;   // frames this device took from another device's queue
+    double busy_seconds = 0.0;  // time with at least one frame on the device
+    double utilization = 0.0;   // busy_seconds / wall time since construction or reset_stats()
+};
+
+// Spreads frames over several InferenceBackends (one per accelerator).
+// submit() queues each frame on the least-loaded device; every device has a feeder thread that
+// drains its own queue and, once empty, steals from the back of the longest other queue, so a
+// slow or stalled device never holds work another device could run. Completions keep their
+// frame_idx, so AsyncPipeline still writes results in query order.
+class MultiDeviceBackend : public InferenceBackend {
+private:
+    struct Job {
+        InferenceRequest request;
+        CompletionHandler on_complete;
+    };
+
+    struct Device {
+        std::shared_ptr<InferenceBackend> backend;
+        std::string name;
+        size_t max_in_flight = 1;
+        std::deque<Job> queue;
+        size_t in_flight = 0;
+        size_t frames = 0;
+        size_t stolen_frames = 0;
+        std::chrono::steady_clock::duration busy_time{0};
+        std::chrono::steady_clock::time_point busy_since;
+        std::thread feeder;
+    };
+
+    std::vector<std::unique_ptr<Device>> m_devices;
+    std::mutex m_mutex;
+    std::condition_variable m_cond_work;     // a queue gained a frame
+    std::condition_variable m_cond_space;    // queued frames dropped below the limit
+    std::condition_variable m_cond_idle;     // a device went idle
+    size_t m_queued = 0;
+    size_t m_queue_limit = 0;
+    bool m_stopped = false;
+    std::chrono::steady_clock::time_point m_stats_since = std::chrono::steady_clock::now();
+
+    // Caller holds m_mutex.
+    bool take_job(size_t device_idx, Job &job) {
+        Device &self = *m_devices[device_idx];
+        if (!self.queue.empty()) {
+            job = std::move(self.queue.front());
+            self.queue.pop_front();
+            return true;
+        }
+        Device *victim = nullptr;
+        for (auto &device : m_devices) {
+            if (!device->queue.empty() && (!victim || device->queue.size() > victim->queue.size())) {
+                victim = device.get();
+            }
+        }
+        if (!victim) {
+            return false;
+        }
+        job = std::move(victim->queue.back());
+        victim->queue.pop_back();
+        self.stolen_frames++;
+        return true;
+    }
+
+    bool has_work() const {
+        for (const auto &device : m_devices) {
+            if (!device->queue.empty()) return true;
+        }
+        return false;
+    }
+
+    void on_device_complete(size_t device_idx) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            Device &device = *m_devices[device_idx];
+            device.frames++;
+            if (0 == --device.in_flight) {
+                device.busy_time += std::chrono::steady_clock::now() - device.busy_since;
+            }
+        }
+        m_cond_idle.notify_all();
+    }
+
+    void feeder_loop(size_t device_idx) {
+        Device &device = *m_devices[device_idx];
+        while (true) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cond_work.wait(lock, [this] { return has_work() || m_stopped; });
+                if (!take_job(device_idx, job)) {
+                    if (m_stopped) return;
+                    continue;
+                }
+                m_queued--;
+                if (0 == device.in_flight++) {
+                    device.busy_since = std::chrono::steady_clock::now();
+                }
+            }
+            m_cond_space.notify_one();
+
+            auto on_complete = std::move(job.on_complete);
+            // Blocks while this device is full; meanwhile the other feeders keep draining the queues.
+            device.backend->submit(std::move(job.request),
+                [this, device_idx, on_complete = std::move(on_complete)](InferenceCompletion &completion) {
+                    on_device_complete(device_idx);
+                    on_complete(completion);
+                });
+        }
+    }
+
+    // Caller holds m_mutex. Load = frames waiting for or running on the device, per unit of capacity.
+    size_t least_loaded_device() const {
+        size_t best = 0;
+        double best_load = 0.0;
+        for (size_t i = 0; i < m_devices.size(); i++) {
+            const Device &device = *m_devices[i];
+            double load = static_cast<double>(device.queue.size() + device.in_flight) / device.max_in_flight;
+            if (0 == i || load < best_load) {
+                best = i;
+                best_load = load;
+            }
+        }
+        return best;
+    }
+
+public:
+    explicit MultiDeviceBackend(const std::vector<std::shared_ptr<InferenceBackend>> &backends) {
+        if (backends.empty()) {
+            throw std::runtime_error("MultiDeviceBackend: no devices to combine");
+        }
+        for (size_t i = 0; i < backends.size(); i++) {
+            auto device = std::make_unique<Device>();
+            auto capabilities = backends[i]->capabilities();
+            device->backend = backends[i];
+            device->name = capabilities.name + " #" + std::to_string(i);
+            device->max_in_flight = std::max<size_t>(capabilities.max_in_flight, 1);
+            m_queue_limit += device->max_in_flight;
+            m_devices.push_back(std::move(device));
+        }
+        for (size_t i = 0; i < m_devices.size(); i++) {
+            m_devices[i]->feeder = std::thread(&MultiDeviceBackend::feeder_loop, this, i);
+        }
+    }
+
+    ~MultiDeviceBackend() override {
+        drain();
+        print_device_utilization();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopped = true;
+        }
+        m_cond_work.notify_all();
+        for (auto &device : m_devices) {
+            device->feeder.join();
+        }
+    }
+
+    MultiDeviceBackend(const MultiDeviceBackend&) = delete;
+    MultiDeviceBackend& operator=(const MultiDeviceBackend&) = delete;
+
+    BackendCapabilities capabilities() const override {
+        BackendCapabilities capabilities;
+        capabilities.name = std::to_string(m_devices.size()) + " devices";
+        capabilities.zero_copy_input = true;
+        capabilities.completes_on_device_thread = false;
+        for (const auto &device : m_devices) {
+            auto device_capabilities = device->backend->capabilities();
+            capabilities.max_in_flight += device_capabilities.max_in_flight;
+            capabilities.input_frame_size = device_capabilities.input_frame_size;
+            capabilities.zero_copy_input = capabilities.zero_copy_input && device_capabilities.zero_copy_input;
+            capabilities.completes_on_device_thread = capabilities.completes_on_device_thread ||
+                                                      device_capabilities.completes_on_device_thread;
+        }
+        return capabilities;
+    }
+
+    void submit(InferenceRequest request, CompletionHandler on_complete) override {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cond_space.wait(lock, [this] { return m_queued < m_queue_limit; });
+            Job job;
+            job.request = std::move(request);
+            job.on_complete = std::move(on_complete);
+            m_devices[least_loaded_device()]->queue.push_back(std::move(job));
+            m_queued++;
+        }
+        m_cond_work.notify_all();
+    }
+
+    void drain() override {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cond_idle.wait(lock, [this] {
+                if (m_queued > 0) return false;
+                for (const auto &device : m_devices) {
+                    if (device->in_flight > 0) return false;
+                }
+                return true;
+            });
+        }
+        for (auto &device : m_devices) {
+            device->backend->drain();
+        }
+    }
+
+    void hint_pending(size_t pending_frames) override {
+        size_t per_device = (pending_frames + m_devices.size() - 1) / m_devices.size();
+        for (auto &device : m_devices) {
+            device->backend->hint_pending(per_device);
+        }
+    }
+
+    size_t device_count() const { return m_devices.size(); }
+
+    std::vector<DeviceUtilization> device_utilization() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto now = std::chrono::steady_clock::now();
+        double wall = std::chrono::duration<double>(now - m_stats_since).count();
+        std::vector<DeviceUtilization> result;
+        for (const auto &device : m_devices) {
+            auto busy = device->busy_time;
+            if (device->in_flight > 0) busy += now - device->busy_since;
+            DeviceUtilization utilization;
+            utilization.name = device->name;
+            utilization.frames = device->frames;
+            utilization.stolen_frames = device->stolen_frames;
+            utilization.busy_seconds = std::chrono::duration<double>(busy).count();
+            utilization.utilization = (wall > 0.0) ? utilization.busy_seconds / wall : 0.0;
+            result.push_back(utilization);
+        }
+        return result;
+    }
+
+    void reset_stats() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats_since = std::chrono::steady_clock::now();
+        for (auto &device : m_devices) {
+            device->frames = 0;
+            device->stolen_frames = 0;
+            device->busy_time = std::chrono::steady_clock::duration(0);
+            device->busy_since = m_stats_since;
+        }
+    }
+
+    void print_device_utilization() {
+        std::cout << "-I-----------------------------------------------" << std::endl;
+        std::cout << "-I- Device utilization                           " << std::endl;
+        std::cout << "-I-----------------------------------------------" << std::endl;
+        for (const auto &device : device_utilization()) {
+            std::cout << "-I- " << std::left << std::setw(24) << device.name << std::right
+                      << " frames: " << std::setw(7) << device.frames
+                      << "  stolen: " << std::setw(6) << device.stolen_frames
+                      << "  busy: " << std::fixed << std::setprecision(1) << std::setw(5) << 100.0 * device.utilization << " %"
+                      << std::defaultfloat << std::endl;
+        }
+        std::cout << "-I-----------------------------------------------" << std::endl;
+    }
+};
+
+// One backend is used as is; several are wrapped in a MultiDeviceBackend.
+inline std::shared_ptr<InferenceBackend> combine_backends(const std::vector<std::shared_ptr<InferenceBackend>> &backends)
+{
+    if (1 == backends.size()) {
+        return backends.front();
+    }
+    return std::make_shared<MultiDeviceBackend>(backends);
+}
+
+#endif /* _MULTI_DEVICE_BACKEND_HPP_ */
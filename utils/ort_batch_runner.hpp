@@ -0,0 +1,247 @@
+#ifndef _ORT_BATCH_RUNNER_HPP_
+#define _ORT_BATCH_RUNNER_HPP_
+
+#include <onnxruntime_cxx_api.h>
+#include "async_pipeline.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Runs queries through an Ort::Session N at a time: up to batch_size() preprocessed frames are
+// packed into one {n, ...} input tensor, the session runs once, and the first output is handed
+// back one frame at a time. With batch 1 most GEMM work can't spread over the cores; with a
+// batch it can. Models whose batch dimension is fixed run with batch 1.
+//
+// The input and output tensors are allocated once per batch size from ORT's default allocator and
+// bound through Ort::IoBinding, so a Run allocates nothing. A batch of n < batch_size() frames uses
+// {n, ...} views over the same memory. A single query is bound straight from its own buffer. If
+// the output has dynamic non-batch dimensions, ORT allocates the output per Run instead.
+class OrtBatchRunner {
+private:
+    // IoBinding of the persistent tensors for n frames (views for n < batch size).
+    struct Binding {
+        Ort::Value input{nullptr};
+        Ort::Value output{nullptr};
+        std::unique_ptr<Ort::IoBinding> io;
+    };
+
+    std::shared_ptr<Ort::Session> m_session;
+    Ort::MemoryInfo m_memory_info = Ort::MemoryInfo::CreateCpu(OrtDeviceAllocator, OrtMemTypeCPU);
+    Ort::RunOptions m_run_options;
+    std::string m_input_name;
+    std::string m_output_name;
+    std::vector<int64_t> m_frame_shape;        // input shape without the batch dimension
+    std::vector<int64_t> m_output_frame_shape; // output shape without the batch dimension
+    size_t m_input_elements = 0;               // floats per frame
+    size_t m_output_elements = 0;              // 0: the output shape is only known after Run
+    bool m_dynamic_batch = false;
+    size_t m_batch_size = 0;
+
+    Ort::Value m_input_tensor{nullptr};  // batch_size frames
+    Ort::Value m_output_tensor{nullptr}; // batch_size frames, when m_output_elements > 0
+    float *m_input_data = nullptr;
+    const float *m_output_data = nullptr;
+    std::vector<Binding> m_bindings;     // [n - 1]: n frames
+    Binding m_direct;                    // one frame, input bound from the query's own buffer
+
+    std::vector<int64_t> batch_shape(const std::vector<int64_t> &frame_shape, size_t n) const {
+        std::vector<int64_t> shape;
+        shape.reserve(frame_shape.size() + 1);
+        shape.push_back(static_cast<int64_t>(n));
+        shape.insert(shape.end(), frame_shape.begin(), frame_shape.end());
+        return shape;
+    }
+
+    Ort::Value view(float *data, size_t elements, const std::vector<int64_t> &shape) const {
+        return Ort::Value::CreateTensor<float>(m_memory_info, data, elements, shape.data(), shape.size());
+    }
+
+    void allocate(size_t batch_size) {
+        m_bindings.clear(); // views of the tensors about to be replaced
+        m_direct = Binding();
+        Ort::AllocatorWithDefaultOptions allocator;
+        const auto input_shape = batch_shape(m_frame_shape, batch_size);
+        m_input_tensor = Ort::Value::CreateTensor<float>(allocator, input_shape.data(), input_shape.size());
+        m_input_data = m_input_tensor.GetTensorMutableData<float>();
+        std::fill(m_input_data, m_input_data + batch_size * m_input_elements, 0.0f);
+
+        float *output_data = nullptr;
+        if (m_output_elements > 0) {
+            const auto output_shape = batch_shape(m_output_frame_shape, batch_size);
+            m_output_tensor = Ort::Value::CreateTensor<float>(allocator, output_shape.data(), output_shape.size());
+            output_data = m_output_tensor.GetTensorMutableData<float>();
+        }
+        m_output_data = output_data;
+
+        m_bindings.resize(batch_size);
+        for (size_t n = 1; n <= batch_size; n++) {
+            Binding &binding = m_bindings[n - 1];
+            binding.input = view(m_input_data, n * m_input_elements, batch_shape(m_frame_shape, n));
+            if (output_data) {
+                binding.output = view(output_data, n * m_output_elements, batch_shape(m_output_frame_shape, n));
+                binding.io = std::make_unique<Ort::IoBinding>(*m_session);
+                binding.io->BindInput(m_input_name.c_str(), binding.input);
+                binding.io->BindOutput(m_output_name.c_str(), binding.output);
+            }
+        }
+        if (output_data) {
+            m_direct.output = view(output_data, m_output_elements, batch_shape(m_output_frame_shape, 1));
+            m_direct.io = std::make_unique<Ort::IoBinding>(*m_session);
+            m_direct.io->BindOutput(m_output_name.c_str(), m_direct.output);
+        }
+    }
+
+    // Runs n frames already in the input tensor; returns the output and its floats per frame.
+    const float *run_bound(size_t n, size_t &per_frame, Ort::Value &owned_output) {
+        Binding &binding = m_bindings[n - 1];
+        if (binding.io) {
+            m_session->Run(m_run_options, *binding.io);
+            per_frame = m_output_elements;
+            return m_output_data;
+        }
+        const char *input_name = m_input_name.c_str();
+        const char *output_name = m_output_name.c_str();
+        auto outputs = m_session->Run(m_run_options, &input_name, &binding.input, 1, &output_name, 1);
+        owned_output = std::move(outputs.front());
+        per_frame = owned_output.GetTensorTypeAndShapeInfo().GetElementCount() / n;
+        return owned_output.GetTensorData<float>();
+    }
+
+public:
+    // batch_size 0 leaves the runner at 1 until tune() or set_batch_size() is called.
+    explicit OrtBatchRunner(std::shared_ptr<Ort::Session> session, size_t batch_size = 1)
+        : m_session(std::move(session))
+    {
+        // Sessions may be built with verbose logging for the placement report (see
+        // OrtPlacementLog); runs only log from warning severity up.
+        m_run_options.SetRunLogSeverityLevel(ORT_LOGGING_LEVEL_WARNING);
+        Ort::AllocatorWithDefaultOptions allocator;
+        m_input_name = m_session->GetInputNameAllocated(0, allocator).get();
+        m_output_name = m_session->GetOutputNameAllocated(0, allocator).get();
+        std::vector<int64_t> shape = m_session->GetInputTypeInfo(0).GetTensorTypeAndShapeInfo().GetShape();
+        if (shape.size() < 2) {
+            throw std::runtime_error("OrtBatchRunner: input " + m_input_name + " has no batch dimension");
+        }
+        m_dynamic_batch = shape[0] < 0;
+        m_frame_shape.assign(shape.begin() + 1, shape.end());
+        m_input_elements = 1;
+        for (int64_t dim : m_frame_shape) {
+            if (dim < 0) {
+                throw std::runtime_error("OrtBatchRunner: input " + m_input_name + " has a dynamic non-batch dimension");
+            }
+            m_input_elements *= static_cast<size_t>(dim);
+        }
+
+        std::vector<int64_t> output_shape = m_session->GetOutputTypeInfo(0).GetTensorTypeAndShapeInfo().GetShape();
+        if (!output_shape.empty()) {
+            m_output_frame_shape.assign(output_shape.begin() + 1, output_shape.end());
+            size_t elements = 1;
+            bool known = true;
+            for (int64_t dim : m_output_frame_shape) {
+                if (dim < 0) known = false;
+                else elements *= static_cast<size_t>(dim);
+            }
+            m_output_elements = known ? elements : 0;
+        }
+        set_batch_size(batch_size);
+    }
+
+    bool dynamic_batch() const { return m_dynamic_batch; }
+    size_t batch_size() const { return m_batch_size; }
+    size_t input_elements() const { return m_input_elements; }
+
+    // Clamped to 1 for a fixed batch dimension. Reallocates the bound tensors when the size changes.
+    void set_batch_size(size_t batch_size) {
+        batch_size = m_dynamic_batch ? std::max<size_t>(1, batch_size) : 1;
+        if (batch_size != m_batch_size) {
+            allocate(batch_size);
+            m_batch_size = batch_size;
+        }
+    }
+
+    // Times batches of 1, 2, 4, ... up to max_batch on a blank input and keeps the size with the
+    // best time per frame. Stops doubling once a step gains less than 5%, since the larger batches
+    // only cost memory from there on. Returns the chosen size.
+    size_t tune(size_t max_batch, int repeats = 3) {
+        if (!m_dynamic_batch || max_batch <= 1) {
+            set_batch_size(1);
+            return m_batch_size;
+        }
+        double best_per_frame = 0.0;
+        size_t best = 1;
+        for (size_t n = 1; n <= max_batch; n *= 2) {
+            set_batch_size(n);
+            size_t per_frame = 0;
+            Ort::Value owned_output{nullptr};
+            run_bound(n, per_frame, owned_output); // warm-up: first run at a new shape plans memory
+            auto start = std::chrono::steady_clock::now();
+            for (int r = 0; r < repeats; r++) run_bound(n, per_frame, owned_output);
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / (repeats * n);
+            std::cout << "-I- ORT batch " << n << ": " << ms << " ms/frame" << std::endl;
+            if (1 == n || ms < best_per_frame * 0.95) {
+                best_per_frame = ms;
+                best = n;
+            } else {
+                break;
+            }
+        }
+        set_batch_size(best);
+        std::cout << "-I- ORT batch size " << best << std::endl;
+        return best;
+    }
+
+    // Runs data[first, first + n) as one batch, n <= batch_size(). on_output(query index, output,
+    // floats per frame) is called for each of them, in order, on the calling thread. The output
+    // pointer is only valid during the call.
+    void run_batch(const std::vector<VariantType> &data, size_t first, size_t n,
+                   const std::function<void(size_t, const float *, size_t)> &on_output) {
+        const size_t frame_bytes = m_input_elements * sizeof(float);
+        const bool direct = 1 == n && m_direct.io;
+        for (size_t i = 0; i < n; i++) {
+            auto bytes = variant_bytes(data[first + i], frame_bytes);
+            if (bytes.second < frame_bytes) {
+                throw std::runtime_error("OrtBatchRunner: query " + std::to_string(first + i) + " has " +
+                                         std::to_string(bytes.second) + " bytes, expected " + std::to_string(frame_bytes));
+            }
+            if (direct) {
+                // ORT only reads from input tensors, CreateTensor just isn't const-qualified.
+                m_direct.input = view(reinterpret_cast<float *>(const_cast<uint8_t *>(bytes.first)), m_input_elements,
+                                      batch_shape(m_frame_shape, 1));
+                m_direct.io->BindInput(m_input_name.c_str(), m_direct.input);
+            } else {
+                std::memcpy(m_input_data + i * m_input_elements, bytes.first, frame_bytes);
+            }
+        }
+
+        size_t per_frame = 0;
+        const float *values = nullptr;
+        Ort::Value owned_output{nullptr};
+        if (direct) {
+            m_session->Run(m_run_options, *m_direct.io);
+            values = m_output_data;
+            per_frame = m_output_elements;
+        } else {
+            values = run_bound(n, per_frame, owned_output);
+        }
+        for (size_t i = 0; i < n; i++) {
+            on_output(first + i, values + i * per_frame, per_frame);
+        }
+    }
+
+    // Every query, in batches of batch_size(); see run_batch.
+    void run(const std::vector<VariantType> &data,
+             const std::function<void(size_t, const float *, size_t)> &on_output) {
+        for (size_t first = 0; first < data.size(); first += m_batch_size) {
+            run_batch(data, first, std::min(m_batch_size, data.size() - first), on_output);
+        }
+    }
+};
+
+#endif /* _ORT_BATCH_RUNNER_HPP_ */
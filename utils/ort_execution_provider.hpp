@@ -0,0 +1,261 @@
+#ifndef _ORT_EXECUTION_PROVIDER_HPP_
+#define _ORT_EXECUTION_PROVIDER_HPP_
+
+#include <onnxruntime_cxx_api.h>
+#include "ort_session_pool.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// The Arm Compute Library / ArmNN providers only exist in ORT builds configured with them, and
+// only those builds install their factory headers.
+#if defined(__has_include)
+#if __has_include(<acl_provider_factory.h>)
+#include <acl_provider_factory.h>
+#define ORT_PROVIDER_ACL_BUILT
+#endif
+#if __has_include(<armnn_provider_factory.h>)
+#include <armnn_provider_factory.h>
+#define ORT_PROVIDER_ARMNN_BUILT
+#endif
+#endif
+
+// Execution provider selection for the CPU examples: a preference list such as
+// "xnnpack,acl,cpu" is tried in order, each provider with its own session options, and the first
+// one whose session builds is kept. Nodes a provider can't take stay on ORT's CPU provider, so the
+// placement report tells how much of the graph actually runs on the faster kernels.
+
+enum class OrtProvider {
+    XNNPACK,
+    ACL,
+    ARMNN,
+    CPU
+};
+
+// Name used in preference lists.
+inline const char *provider_name(OrtProvider provider)
+{
+    switch (provider) {
+    case OrtProvider::XNNPACK: return "xnnpack";
+    case OrtProvider::ACL:     return "acl";
+    case OrtProvider::ARMNN:   return "armnn";
+    default:                   return "cpu";
+    }
+}
+
+// Name in Ort::GetAvailableProviders() and in ORT's logs.
+inline const char *provider_ort_name(OrtProvider provider)
+{
+    switch (provider) {
+    case OrtProvider::XNNPACK: return "XnnpackExecutionProvider";
+    case OrtProvider::ACL:     return "ACLExecutionProvider";
+    case OrtProvider::ARMNN:   return "ArmNNExecutionProvider";
+    default:                   return "CPUExecutionProvider";
+    }
+}
+
+// Comma-separated, case-insensitive. The CPU provider is appended when missing so there is
+// always something to fall back to.
+inline std::vector<OrtProvider> parse_provider_list(const std::string &list)
+{
+    std::vector<OrtProvider> providers;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        item.erase(std::remove_if(item.begin(), item.end(), [](unsigned char c) { return std::isspace(c); }), item.end());
+        std::transform(item.begin(), item.end(), item.begin(), [](unsigned char c) { return std::tolower(c); });
+        if (item.empty()) continue;
+        OrtProvider provider;
+        if ("xnnpack" == item) provider = OrtProvider::XNNPACK;
+        else if ("acl" == item) provider = OrtProvider::ACL;
+        else if ("armnn" == item) provider = OrtProvider::ARMNN;
+        else if ("cpu" == item) provider = OrtProvider::CPU;
+        else throw std::runtime_error("parse_provider_list: unknown execution provider '" + item + "'");
+        if (std::find(providers.begin(), providers.end(), provider) == providers.end()) providers.push_back(provider);
+    }
+    if (std::find(providers.begin(), providers.end(), OrtProvider::CPU) == providers.end()) {
+        providers.push_back(OrtProvider::CPU);
+    }
+    return providers;
+}
+
+// Built into the linked ORT library (and, for ACL/ArmNN, into this binary).
+inline bool provider_available(OrtProvider provider)
+{
+    if (OrtProvider::CPU == provider) return true;
+#if !defined(ORT_PROVIDER_ACL_BUILT)
+    if (OrtProvider::ACL == provider) return false;
+#endif
+#if !defined(ORT_PROVIDER_ARMNN_BUILT)
+    if (OrtProvider::ARMNN == provider) return false;
+#endif
+    const auto available = Ort::GetAvailableProviders();
+    return std::find(available.begin(), available.end(), provider_ort_name(provider)) != available.end();
+}
+
+// Appends the provider with the options it runs best with. intra_op_threads is the session's
+// thread count (0: ORT's default).
+inline void append_provider(Ort::SessionOptions &options, OrtProvider provider, int intra_op_threads)
+{
+    switch (provider) {
+    case OrtProvider::XNNPACK: {
+        // XNNPACK runs its nodes on its own thread pool, created while the session is built and so
+        // inheriting the building thread's CPU affinity. ORT's pool only keeps the nodes XNNPACK
+        // can't take; without spinning its threads don't compete with XNNPACK's for the cores.
+        std::unordered_map<std::string, std::string> xnnpack_options;
+        if (intra_op_threads > 0) xnnpack_options["intra_op_num_threads"] = std::to_string(intra_op_threads);
+        options.AddConfigEntry("session.intra_op.allow_spinning", "0");
+        options.AppendExecutionProvider("XNNPACK", xnnpack_options);
+        break;
+    }
+    case OrtProvider::ACL:
+#if defined(ORT_PROVIDER_ACL_BUILT)
+        // Second argument: use_arena on older ORT, enable_fast_math on newer. Off either way, since
+        // fast math switches convolutions to Winograd/bf16 and moves the accuracy.
+        Ort::ThrowOnError(OrtSessionOptionsAppendExecutionProvider_ACL(options, 0));
+#endif
+        break;
+    case OrtProvider::ARMNN:
+#if defined(ORT_PROVIDER_ARMNN_BUILT)
+        Ort::ThrowOnError(OrtSessionOptionsAppendExecutionProvider_ArmNN(options, 1));
+#endif
+        break;
+    default:
+        break; // ORT's CPU provider is always registered last
+    }
+}
+
+// Collects ORT's node placement messages, which it only logs at verbose severity while a session
+// is built. Pass log() and this object to the Ort::Env; messages other than placements are
+// forwarded to std::cerr from warning severity up, like ORT's default logger.
+class OrtPlacementLog {
+private:
+    std::mutex m_mutex;
+    std::map<std::string, std::vector<std::string>> m_placements; // by session log id
+    int m_next_id = 0;
+
+public:
+    static void ORT_API_CALL log(void *param, OrtLoggingLevel severity, const char *category, const char *logid,
+                                 const char *code_location, const char *message) {
+        auto *self = static_cast<OrtPlacementLog *>(param);
+        const std::string text = message ? message : "";
+        if (text.find("Node placements") != std::string::npos) return; // heading of the lines below
+        if (text.find("placed on [") != std::string::npos ||
+            (ORT_LOGGING_LEVEL_VERBOSE == severity && 0 == text.compare(0, 2, "  "))) {
+            std::lock_guard<std::mutex> lock(self->m_mutex);
+            auto it = self->m_placements.find(logid ? logid : "");
+            if (it != self->m_placements.end()) it->second.push_back(text);
+            return;
+        }
+        if (severity >= ORT_LOGGING_LEVEL_WARNING) {
+            std::cerr << "-W- [ORT " << (category ? category : "") << "] " << (code_location ? code_location : "") << " "
+                      << text << std::endl;
+        }
+    }
+
+    // A log id for the next session to build; its placements are collected under it.
+    std::string next_log_id() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::string id = "bmt-session-" + std::to_string(m_next_id++);
+        m_placements[id];
+        return id;
+    }
+
+    std::vector<std::string> take(const std::string &log_id) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_placements.find(log_id);
+        if (it == m_placements.end()) return {};
+        std::vector<std::string> lines = std::move(it->second);
+        m_placements.erase(it);
+        return lines;
+    }
+};
+
+// A session built with one of the preferred providers.
+struct OrtProviderSession {
+    std::shared_ptr<Ort::Session> session;
+    OrtProvider provider = OrtProvider::CPU;
+    std::vector<std::string> placements; // ORT's placement messages, empty without a placement log
+
+    // "xnnpack", then one line per provider ORT placed nodes on (with the nodes when
+    // list_nodes is set).
+    void report(std::ostream &out, bool list_nodes) const {
+        out << "-I- ORT execution provider: " << provider_name(provider) << std::endl;
+        for (const auto &line : placements) {
+            const bool node = 0 == line.compare(0, 2, "  "); // node names follow their provider's line
+            if (node && !list_nodes) continue;
+            const size_t start = line.find_first_not_of(' ');
+            if (std::string::npos != start) out << "-I-   " << line.substr(start) << std::endl;
+        }
+    }
+};
+
+// Tries providers in order, each on its own copy of options, until a session builds. A provider
+// that isn't built in is skipped; one that fails to build the session is reported and skipped.
+// create builds the session from the options prepared for the given provider; placement_log,
+// when given, must be the one passed to the Ort::Env.
+inline OrtProviderSession create_session_with_providers(
+    const Ort::SessionOptions &options, const std::vector<OrtProvider> &providers, int intra_op_threads,
+    const std::function<std::shared_ptr<Ort::Session>(const Ort::SessionOptions &, OrtProvider)> &create,
+    OrtPlacementLog *placement_log = nullptr)
+{
+    std::string failures;
+    for (OrtProvider provider : providers) {
+        if (!provider_available(provider)) {
+            failures += std::string(failures.empty() ? "" : "; ") + provider_name(provider) + ": not built in";
+            continue;
+        }
+        Ort::SessionOptions provider_options = options.Clone();
+        std::string log_id;
+        if (placement_log) {
+            log_id = placement_log->next_log_id();
+            provider_options.SetLogId(log_id.c_str());
+            provider_options.SetLogSeverityLevel(ORT_LOGGING_LEVEL_VERBOSE);
+        }
+        try {
+            append_provider(provider_options, provider, intra_op_threads);
+            OrtProviderSession result;
+            result.session = create(provider_options, provider);
+            result.provider = provider;
+            if (placement_log) result.placements = placement_log->take(log_id);
+            return result;
+        } catch (const Ort::Exception &ex) {
+            if (placement_log) placement_log->take(log_id);
+            std::cerr << "-W- ORT execution provider " << provider_name(provider) << " failed: " << ex.what() << std::endl;
+            failures += std::string(failures.empty() ? "" : "; ") + provider_name(provider) + ": " + ex.what();
+        }
+    }
+    throw std::runtime_error("No ORT execution provider could build the session (" + failures + ")");
+}
+
+// OrtSessionPool factory building every session through create_session_with_providers and
+// printing each one's provider report as it is built. The pool's sessions all run the same model,
+// so only the first report lists the nodes.
+inline OrtSessionPool::SessionFactory provider_session_factory(
+    std::vector<OrtProvider> providers,
+    std::function<std::shared_ptr<Ort::Session>(const Ort::SessionOptions &, OrtProvider)> create,
+    OrtPlacementLog *placement_log = nullptr)
+{
+    auto report_mutex = std::make_shared<std::mutex>();
+    auto reported = std::make_shared<bool>(false);
+    return [=](const Ort::SessionOptions &options, const OrtSessionSlot &slot) {
+        OrtProviderSession built =
+            create_session_with_providers(options, providers, slot.intra_op_threads, create, placement_log);
+        std::lock_guard<std::mutex> lock(*report_mutex);
+        built.report(std::cout, !*reported);
+        *reported = true;
+        return built.session;
+    };
+}
+
+#endif /* _ORT_EXECUTION_PROVIDER_HPP_ */
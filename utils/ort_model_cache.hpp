@@ -0,0 +1,227 @@
+#ifndef _ORT_MODEL_CACHE_HPP_
+#define _ORT_MODEL_CACHE_HPP_
+
+#include <onnxruntime_cxx_api.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <set>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#if defined(__unix__)
+#include <sys/utsname.h>
+#endif
+
+// Keeps the graph ORT optimized for a model next to it, in ORT format, so later launches load it
+// instead of re-running the graph optimizations (seconds for DeepLabV3 or YOLO on a Pi). A cache
+// file is only valid for the model bytes, ORT version, optimization level, execution provider and
+// CPU it was built with (ORT picks kernels and layouts by the CPU's features), so all five go into
+// its name: <model stem>.<key>.ort. Stale files from other keys are left alone.
+
+namespace model_cache_detail {
+
+// FNV-1a, 64-bit.
+inline uint64_t hash_bytes(const char *data, size_t size, uint64_t hash = 14695981039346656037ull)
+{
+    for (size_t i = 0; i < size; i++) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+inline uint64_t hash_file(const std::filesystem::path &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) throw std::runtime_error("OrtModelCache: can't read " + path.string());
+    std::vector<char> chunk(1 << 20);
+    uint64_t hash = hash_bytes(nullptr, 0);
+    while (file) {
+        file.read(chunk.data(), chunk.size());
+        hash = hash_bytes(chunk.data(), static_cast<size_t>(file.gcount()), hash);
+    }
+    return hash;
+}
+
+// The model's hash, remembered in <model>.fnv64 together with the size and modification time it
+// was computed for, so a launch only reads the whole model again after it changed.
+inline uint64_t model_hash(const std::filesystem::path &path)
+{
+    std::error_code error;
+    const auto size = std::filesystem::file_size(path, error);
+    if (error) throw std::runtime_error("OrtModelCache: can't read " + path.string());
+    const auto mtime = std::filesystem::last_write_time(path, error).time_since_epoch().count();
+    const std::filesystem::path sidecar = std::filesystem::path(path).concat(".fnv64");
+
+    unsigned long long stored_size = 0, stored_hash = 0;
+    long long stored_mtime = 0;
+    std::ifstream stored(sidecar);
+    if (!error && stored >> stored_size >> stored_mtime >> std::hex >> stored_hash &&
+        stored_size == size && stored_mtime == static_cast<long long>(mtime)) {
+        return stored_hash;
+    }
+    const uint64_t hash = hash_file(path);
+    if (!error) {
+        std::ofstream(sidecar) << size << ' ' << static_cast<long long>(mtime) << ' ' << std::hex << hash << std::endl;
+    }
+    return hash;
+}
+
+// Machine and CPU model: uname's machine, plus /proc/cpuinfo's model name (x86) or the distinct
+// implementer/part pairs (Arm, one per core type on big.LITTLE parts).
+inline std::string hardware_id()
+{
+    std::string id;
+#if defined(__unix__)
+    struct utsname name;
+    if (0 == uname(&name)) id = name.machine;
+#endif
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::set<std::string> cores;
+    std::string line, model, implementer;
+    while (std::getline(cpuinfo, line)) {
+        const size_t colon = line.find(':');
+        if (std::string::npos == colon) continue;
+        std::string key = line.substr(0, colon);
+        key.erase(key.find_last_not_of(" \t") + 1);
+        const std::string value = line.substr(std::min(line.size(), colon + 2));
+        if ("model name" == key && model.empty()) model = value;
+        else if ("CPU implementer" == key) implementer = value;
+        else if ("CPU part" == key) cores.insert(implementer + "/" + value);
+    }
+    if (!model.empty()) id += "|" + model;
+    for (const auto &core : cores) id += "|" + core;
+    return id;
+}
+
+inline double elapsed_ms(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace model_cache_detail
+
+class OrtModelCache {
+private:
+    Ort::Env &m_env;
+    std::filesystem::path m_model_path;
+    GraphOptimizationLevel m_level;
+    bool m_enabled;
+    uint64_t m_model_hash = 0;
+    std::string m_hardware;
+    std::mutex m_build_mutex; // one build writes a given cache file; the others then load it
+
+    std::filesystem::path cache_path(const std::string &variant) const {
+        std::ostringstream key;
+        key << m_model_hash << '|' << Ort::GetVersionString() << '|' << static_cast<int>(m_level) << '|' << variant
+            << '|' << m_hardware;
+        const std::string text = key.str();
+        char name[17];
+        std::snprintf(name, sizeof(name), "%016llx",
+                      static_cast<unsigned long long>(model_cache_detail::hash_bytes(text.data(), text.size())));
+        std::filesystem::path path = m_model_path;
+        path.replace_extension(std::string(".") + name + ".ort");
+        return path;
+    }
+
+    std::shared_ptr<Ort::Session> load(const std::filesystem::path &model, const Ort::SessionOptions &options) {
+        return std::make_shared<Ort::Session>(m_env, model.c_str(), options);
+    }
+
+    // Build time of a cache file, kept beside it so a cached launch can show what it saved.
+    static std::filesystem::path build_time_path(const std::filesystem::path &cache) {
+        return std::filesystem::path(cache).concat(".ms");
+    }
+
+    // The session from the cache file when there is a usable one, otherwise null.
+    std::shared_ptr<Ort::Session> load_cached(const std::filesystem::path &cache, const Ort::SessionOptions &options) {
+        std::error_code error;
+        if (!std::filesystem::exists(cache, error)) return nullptr;
+        Ort::SessionOptions cached_options = options.Clone();
+        cached_options.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_DISABLE_ALL); // done before saving
+        cached_options.AddConfigEntry("session.load_model_format", "ORT");
+        const auto start = std::chrono::steady_clock::now();
+        try {
+            auto session = load(cache, cached_options);
+            std::cout << "-I- ORT model cache: loaded " << cache.filename().string() << " in "
+                      << model_cache_detail::elapsed_ms(start) << " ms";
+            std::ifstream build_time(build_time_path(cache));
+            double build_ms = 0.0;
+            if (build_time >> build_ms) std::cout << " (" << build_ms << " ms to optimize the model)";
+            std::cout << std::endl;
+            return session;
+        } catch (const Ort::Exception &ex) {
+            std::cerr << "-W- ORT model cache: " << cache.string() << " unusable, rebuilding: " << ex.what() << std::endl;
+            std::filesystem::remove(cache, error);
+            return nullptr;
+        }
+    }
+
+public:
+    // level is applied to every session built from the model; with enabled false every launch
+    // optimizes the model as before.
+    OrtModelCache(Ort::Env &env, const std::string &model_path, GraphOptimizationLevel level, bool enabled = true)
+        : m_env(env), m_model_path(model_path), m_level(level), m_enabled(enabled)
+    {
+        if (m_enabled) {
+            m_model_hash = model_cache_detail::model_hash(m_model_path);
+            m_hardware = model_cache_detail::hardware_id();
+        }
+    }
+
+    // Builds a session from the cached optimized model when there is one, otherwise from the model,
+    // saving the optimized graph on the way. variant names whatever else changes the optimized
+    // graph, i.e. the execution provider. Safe to call from several threads.
+    std::shared_ptr<Ort::Session> create(const Ort::SessionOptions &options, const std::string &variant) {
+        Ort::SessionOptions session_options = options.Clone();
+        session_options.SetGraphOptimizationLevel(m_level);
+        if (!m_enabled) return load(m_model_path, session_options);
+
+        const std::filesystem::path cache = cache_path(variant);
+        if (auto session = load_cached(cache, options)) return session;
+
+        // One thread builds the file; the others wait and then load it.
+        std::lock_guard<std::mutex> lock(m_build_mutex);
+        if (auto session = load_cached(cache, options)) return session;
+
+        // Written under a temporary name and renamed, so an interrupted build leaves no cache.
+        const std::filesystem::path partial = std::filesystem::path(cache).concat(".partial");
+        Ort::SessionOptions save_options = session_options.Clone();
+        save_options.SetOptimizedModelFilePath(partial.c_str());
+        save_options.AddConfigEntry("session.save_model_format", "ORT");
+        std::error_code error;
+        const auto start = std::chrono::steady_clock::now();
+        try {
+            auto session = load(m_model_path, save_options);
+            const double build_ms = model_cache_detail::elapsed_ms(start);
+            std::ofstream(build_time_path(cache)) << build_ms << std::endl;
+            std::filesystem::rename(partial, cache, error);
+            std::cout << "-I- ORT model cache: optimized the model in " << build_ms << " ms";
+            if (error) {
+                std::cout << std::endl;
+                std::cerr << "-W- ORT model cache: can't write " << cache.string() << ": " << error.message() << std::endl;
+            } else {
+                std::cout << ", saved as " << cache.filename().string() << std::endl;
+            }
+            return session;
+        } catch (const Ort::Exception &ex) {
+            // e.g. a provider that compiles nodes into its own kernels can't be serialized.
+            std::filesystem::remove(partial, error);
+            std::cerr << "-W- ORT model cache: not saving " << cache.filename().string() << ": " << ex.what() << std::endl;
+        }
+        return load(m_model_path, session_options);
+    }
+};
+
+#endif /* _ORT_MODEL_CACHE_HPP_ */
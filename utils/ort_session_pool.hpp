@@ -0,0 +1,249 @@
+#ifndef _ORT_SESSION_POOL_HPP_
+#define _ORT_SESSION_POOL_HPP_
+
+#include <onnxruntime_cxx_api.h>
+#include "ort_batch_runner.hpp"
+#include "worker_pool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// K ORT sessions of the same model, each with its own intra-op thread count and CPU set, fed from
+// one query list. On big.LITTLE parts (RK3588: 4x A76 + 4x A55) two sessions pinned one per
+// cluster beat one session spread over all cores, whose A76 threads keep waiting on the A55 ones.
+// Every session runs on its own dispatch thread, which claims the next batch whenever its session
+// is free (least-loaded dispatch), and keeps per-session latency so topologies can be compared.
+
+// One session of the pool.
+struct OrtSessionSlot {
+    int intra_op_threads = 0; // 0: one per CPU in cpus, or ORT's default when cpus is empty
+    std::vector<int> cpus;    // logical CPU ids (0-based); empty: not pinned
+};
+
+// Formats/parses the CPU list used in topologies: "0-3", "4,5,6,7", "0,2-3".
+inline std::string cpu_list_string(const std::vector<int> &cpus)
+{
+    std::string s;
+    for (size_t i = 0; i < cpus.size(); i++) {
+        s += (i ? "," : "") + std::to_string(cpus[i]);
+    }
+    return s;
+}
+
+inline std::vector<int> parse_cpu_list(const std::string &list)
+{
+    std::vector<int> cpus;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (item.empty()) continue;
+        const size_t dash = item.find('-');
+        const int first = std::stoi(item.substr(0, dash));
+        const int last = (std::string::npos == dash) ? first : std::stoi(item.substr(dash + 1));
+        for (int cpu = first; cpu <= last; cpu++) cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+// "threads@cpus" per session, sessions separated by ';'. Either half may be left out:
+// "4@4-7;4@0-3" is one 4-thread session per RK3588 cluster, "2;2" two unpinned 2-thread sessions.
+// An empty topology is one unpinned session with ORT's default thread count.
+inline std::vector<OrtSessionSlot> parse_session_topology(const std::string &topology)
+{
+    std::vector<OrtSessionSlot> slots;
+    std::stringstream stream(topology);
+    std::string entry;
+    while (std::getline(stream, entry, ';')) {
+        if (entry.empty()) continue;
+        OrtSessionSlot slot;
+        const size_t at = entry.find('@');
+        const std::string threads = entry.substr(0, at);
+        if (!threads.empty()) slot.intra_op_threads = std::stoi(threads);
+        if (std::string::npos != at) slot.cpus = parse_cpu_list(entry.substr(at + 1));
+        slots.push_back(slot);
+    }
+    if (slots.empty()) slots.emplace_back();
+    return slots;
+}
+
+// Restricts the calling thread to cpus; false where that isn't supported.
+inline bool pin_current_thread(const std::vector<int> &cpus)
+{
+#if defined(__linux__)
+    if (cpus.empty()) return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) CPU_SET(cpu, &set);
+    return 0 == pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void)cpus;
+    return false;
+#endif
+}
+
+class OrtSessionPool {
+public:
+    // Creates one session from the options prepared for a slot (see the constructor). The slot
+    // has its thread count resolved, e.g. for execution providers with their own thread pool.
+    using SessionFactory = std::function<std::shared_ptr<Ort::Session>(const Ort::SessionOptions &, const OrtSessionSlot &)>;
+
+private:
+    struct Slot {
+        OrtSessionSlot config;
+        std::unique_ptr<WorkerPool> thread; // the dispatch thread, pinned like the session
+        std::shared_ptr<Ort::Session> session;
+        std::unique_ptr<OrtBatchRunner> runner;
+        // Written by the slot's thread only, read once run() has returned.
+        size_t batches = 0;
+        size_t frames = 0;
+        double busy_ms = 0.0;
+        double max_ms = 0.0;
+    };
+
+    std::vector<std::unique_ptr<Slot>> m_slots;
+
+    // Runs fn on every slot's thread at once and waits; rethrows the first exception.
+    void on_each_slot(const std::function<void(Slot &)> &fn) {
+        CompletionLatch done(m_slots.size());
+        std::mutex error_mutex;
+        std::exception_ptr error;
+        for (auto &slot : m_slots) {
+            Slot *s = slot.get();
+            s->thread->post([&, s] {
+                try {
+                    fn(*s);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(error_mutex);
+                    if (!error) error = std::current_exception();
+                }
+                done.count_down();
+            });
+        }
+        done.wait();
+        if (error) std::rethrow_exception(error);
+    }
+
+public:
+    // Each session gets a copy of options with its intra-op thread count and, when pinned, its
+    // intra-op thread affinities; the session is created on the slot's (pinned) dispatch thread.
+    OrtSessionPool(const std::vector<OrtSessionSlot> &slots, const Ort::SessionOptions &options,
+                   const SessionFactory &create_session) {
+        for (const auto &config : slots) {
+            auto slot = std::make_unique<Slot>();
+            slot->config = config;
+            if (slot->config.intra_op_threads <= 0 && !slot->config.cpus.empty()) {
+                slot->config.intra_op_threads = static_cast<int>(slot->config.cpus.size());
+            }
+            slot->thread = std::make_unique<WorkerPool>(1);
+            m_slots.push_back(std::move(slot));
+        }
+
+        on_each_slot([&options, &create_session](Slot &slot) {
+            const OrtSessionSlot &config = slot.config;
+            Ort::SessionOptions session_options = options.Clone();
+            if (config.intra_op_threads > 0) {
+                session_options.SetIntraOpNumThreads(config.intra_op_threads);
+            }
+            if (!config.cpus.empty()) {
+                pin_current_thread(config.cpus);
+                // One entry per pool thread (the calling thread is the first intra-op thread and
+                // is pinned above). ORT numbers processors from 1.
+                std::string affinities;
+                for (int t = 1; t < config.intra_op_threads; t++) {
+                    affinities += (t > 1 ? ";" : "") + std::to_string(config.cpus[t % config.cpus.size()] + 1);
+                }
+                if (!affinities.empty()) {
+                    session_options.AddConfigEntry("session.intra_op_thread_affinities", affinities.c_str());
+                }
+            }
+            slot.session = create_session(session_options, config);
+            slot.runner = std::make_unique<OrtBatchRunner>(slot.session);
+        });
+    }
+
+    size_t size() const { return m_slots.size(); }
+    std::shared_ptr<Ort::Session> session(size_t index = 0) const { return m_slots[index]->session; }
+
+    void set_batch_size(size_t batch_size) {
+        for (auto &slot : m_slots) slot->runner->set_batch_size(batch_size);
+    }
+
+    // Tunes each session's batch size on its own thread, one session at a time so the timings
+    // don't disturb each other.
+    void tune(size_t max_batch) {
+        for (size_t i = 0; i < m_slots.size(); i++) {
+            Slot &slot = *m_slots[i];
+            std::cout << "-I- ORT session " << i << ":" << std::endl;
+            std::exception_ptr error;
+            slot.thread->post([&slot, &error, max_batch] {
+                try {
+                    slot.runner->tune(max_batch);
+                } catch (...) {
+                    error = std::current_exception();
+                }
+            });
+            slot.thread->wait_idle();
+            if (error) std::rethrow_exception(error);
+        }
+    }
+
+    // Runs every query; each session takes the next batch of its own size as soon as it is free.
+    // on_output(query index, output, floats per frame) is called on the sessions' threads,
+    // concurrently for different queries and in no particular order across sessions.
+    void run(const std::vector<VariantType> &data,
+             const std::function<void(size_t, const float *, size_t)> &on_output) {
+        std::mutex next_mutex;
+        size_t next = 0;
+        on_each_slot([&](Slot &slot) {
+            while (true) {
+                size_t first, n;
+                {
+                    std::lock_guard<std::mutex> lock(next_mutex);
+                    first = next;
+                    n = std::min(slot.runner->batch_size(), data.size() - first);
+                    next += n;
+                }
+                if (0 == n) return;
+                auto start = std::chrono::steady_clock::now();
+                slot.runner->run_batch(data, first, n, on_output);
+                const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                slot.batches++;
+                slot.frames += n;
+                slot.busy_ms += ms;
+                slot.max_ms = std::max(slot.max_ms, ms);
+            }
+        });
+    }
+
+    // Per session since construction: topology, batches, frames, mean and worst batch latency.
+    void report(std::ostream &out) const {
+        for (size_t i = 0; i < m_slots.size(); i++) {
+            const Slot &slot = *m_slots[i];
+            const int threads = slot.config.intra_op_threads;
+            out << "-I- ORT session " << i << " (" << (threads > 0 ? std::to_string(threads) : std::string("default")) << " threads"
+                << (slot.config.cpus.empty() ? "" : " on CPUs " + cpu_list_string(slot.config.cpus))
+                << ", batch " << slot.runner->batch_size() << "): " << slot.frames << " frames in " << slot.batches << " runs";
+            if (slot.batches > 0) {
+                out << ", " << slot.busy_ms / slot.batches << " ms/run mean, " << slot.max_ms << " ms max, "
+                    << slot.frames * 1000.0 / slot.busy_ms << " frames/s busy";
+            }
+            out << std::endl;
+        }
+    }
+};
+
+#endif /* _ORT_SESSION_POOL_HPP_ */
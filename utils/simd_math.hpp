@@ -0,0 +1,139 @@
+#ifndef _SIMD_MATH_HPP_
+#define _SIMD_MATH_HPP_
+
+#include <cstdint>
+#include <cstring>
+
+// Four-lane float helpers for the postprocessing kernels. NEON on the ARM64 boards, SSE2 on
+// x86-64 so the same kernels can be checked on a desktop. Without either, SIMD_MATH_ENABLED
+// is 0 and callers use their scalar path.
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SIMD_MATH_NEON 1
+#define SIMD_MATH_ENABLED 1
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SIMD_MATH_SSE2 1
+#define SIMD_MATH_ENABLED 1
+#else
+#define SIMD_MATH_ENABLED 0
+#endif
+
+#if SIMD_MATH_ENABLED
+namespace simd {
+
+#if defined(SIMD_MATH_NEON)
+using f32x4 = float32x4_t;
+using i32x4 = int32x4_t;
+using mask4 = uint32x4_t;
+
+inline f32x4 load(const float *p) { return vld1q_f32(p); }
+inline void store(float *p, f32x4 v) { vst1q_f32(p, v); }
+inline f32x4 set1(float v) { return vdupq_n_f32(v); }
+inline f32x4 set(float a, float b, float c, float d) { const float v[4] = {a, b, c, d}; return vld1q_f32(v); }
+inline f32x4 add(f32x4 a, f32x4 b) { return vaddq_f32(a, b); }
+inline f32x4 sub(f32x4 a, f32x4 b) { return vsubq_f32(a, b); }
+inline f32x4 mul(f32x4 a, f32x4 b) { return vmulq_f32(a, b); }
+inline f32x4 min(f32x4 a, f32x4 b) { return vminq_f32(a, b); }
+inline f32x4 max(f32x4 a, f32x4 b) { return vmaxq_f32(a, b); }
+inline f32x4 neg(f32x4 a) { return vnegq_f32(a); }
+inline f32x4 div(f32x4 a, f32x4 b) {
+#if defined(__aarch64__)
+    return vdivq_f32(a, b);
+#else
+    f32x4 r = vrecpeq_f32(b);
+    r = vmulq_f32(vrecpsq_f32(b, r), r);
+    r = vmulq_f32(vrecpsq_f32(b, r), r);
+    return vmulq_f32(a, r);
+#endif
+}
+// Lanes where mask is set come from a, the others from b.
+inline f32x4 select(mask4 mask, f32x4 a, f32x4 b) { return vbslq_f32(mask, a, b); }
+inline mask4 lane_mask(bool l0, bool l1, bool l2, bool l3) {
+    const uint32_t m[4] = {l0 ? ~0u : 0u, l1 ? ~0u : 0u, l2 ? ~0u : 0u, l3 ? ~0u : 0u};
+    return vld1q_u32(m);
+}
+inline i32x4 to_int_trunc(f32x4 a) { return vcvtq_s32_f32(a); }
+inline f32x4 to_float(i32x4 a) { return vcvtq_f32_s32(a); }
+inline f32x4 floor(f32x4 a) {
+    f32x4 t = vcvtq_f32_s32(vcvtq_s32_f32(a));
+    return vsubq_f32(t, vbslq_f32(vcgtq_f32(t, a), vdupq_n_f32(1.0f), vdupq_n_f32(0.0f)));
+}
+// 2^n for integer n in [-126, 127].
+inline f32x4 pow2i(i32x4 n) { return vreinterpretq_f32_s32(vshlq_n_s32(vaddq_s32(n, vdupq_n_s32(127)), 23)); }
+// Four unsigned integers widened to float (quantized tensors).
+inline f32x4 load_u8(const uint8_t *p) {
+    uint32_t bytes;
+    std::memcpy(&bytes, p, sizeof(bytes));
+    return vcvtq_f32_u32(vmovl_u16(vget_low_u16(vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(bytes))))));
+}
+inline f32x4 load_u16(const uint16_t *p) { return vcvtq_f32_u32(vmovl_u16(vld1_u16(p))); }
+
+#elif defined(SIMD_MATH_SSE2)
+using f32x4 = __m128;
+using i32x4 = __m128i;
+using mask4 = __m128;
+
+inline f32x4 load(const float *p) { return _mm_loadu_ps(p); }
+inline void store(float *p, f32x4 v) { _mm_storeu_ps(p, v); }
+inline f32x4 set1(float v) { return _mm_set1_ps(v); }
+inline f32x4 set(float a, float b, float c, float d) { return _mm_setr_ps(a, b, c, d); }
+inline f32x4 add(f32x4 a, f32x4 b) { return _mm_add_ps(a, b); }
+inline f32x4 sub(f32x4 a, f32x4 b) { return _mm_sub_ps(a, b); }
+inline f32x4 mul(f32x4 a, f32x4 b) { return _mm_mul_ps(a, b); }
+inline f32x4 div(f32x4 a, f32x4 b) { return _mm_div_ps(a, b); }
+inline f32x4 min(f32x4 a, f32x4 b) { return _mm_min_ps(a, b); }
+inline f32x4 max(f32x4 a, f32x4 b) { return _mm_max_ps(a, b); }
+inline f32x4 neg(f32x4 a) { return _mm_xor_ps(a, _mm_set1_ps(-0.0f)); }
+// Lanes where mask is set come from a, the others from b.
+inline f32x4 select(mask4 mask, f32x4 a, f32x4 b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+inline mask4 lane_mask(bool l0, bool l1, bool l2, bool l3) {
+    return _mm_castsi128_ps(_mm_setr_epi32(l0 ? -1 : 0, l1 ? -1 : 0, l2 ? -1 : 0, l3 ? -1 : 0));
+}
+inline i32x4 to_int_trunc(f32x4 a) { return _mm_cvttps_epi32(a); }
+inline f32x4 to_float(i32x4 a) { return _mm_cvtepi32_ps(a); }
+inline f32x4 floor(f32x4 a) {
+    f32x4 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a));
+    return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, a), _mm_set1_ps(1.0f)));
+}
+inline f32x4 pow2i(i32x4 n) { return _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(n, _mm_set1_epi32(127)), 23)); }
+// Four unsigned integers widened to float (quantized tensors).
+inline f32x4 load_u8(const uint8_t *p) {
+    int32_t bytes;
+    std::memcpy(&bytes, p, sizeof(bytes));
+    const __m128i zero = _mm_setzero_si128();
+    return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero), zero));
+}
+inline f32x4 load_u16(const uint16_t *p) {
+    return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(p)), _mm_setzero_si128()));
+}
+#endif
+
+// e^x, Cephes expf polynomial: max relative error ~2e-7 over the clamped range, i.e. within
+// a couple of ulp of std::exp. Inputs are clamped to [-87.3, 88.0] so the result never
+// overflows to inf or flushes to zero mid-computation.
+inline f32x4 exp(f32x4 x) {
+    x = min(max(x, set1(-87.3f)), set1(88.0f));
+    f32x4 fx = floor(add(mul(x, set1(1.44269504088896341f)), set1(0.5f)));
+    x = sub(x, mul(fx, set1(0.693359375f)));
+    x = sub(x, mul(fx, set1(-2.12194440e-4f)));
+    f32x4 y = set1(1.9875691500e-4f);
+    y = add(mul(y, x), set1(1.3981999507e-3f));
+    y = add(mul(y, x), set1(8.3334519073e-3f));
+    y = add(mul(y, x), set1(4.1665795894e-2f));
+    y = add(mul(y, x), set1(1.6666665459e-1f));
+    y = add(mul(y, x), set1(5.0000001201e-1f));
+    y = add(add(mul(mul(y, x), x), x), set1(1.0f));
+    return mul(y, pow2i(to_int_trunc(fx)));
+}
+
+// 1 / (1 + e^-x), absolute error below 1e-7 against the std::exp formulation.
+inline f32x4 sigmoid(f32x4 x) {
+    const f32x4 one = set1(1.0f);
+    return div(one, add(one, exp(neg(x))));
+}
+
+} // namespace simd
+#endif
+
+#endif /* _SIMD_MATH_HPP_ */
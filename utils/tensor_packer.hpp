@@ -0,0 +1,181 @@
+#ifndef _TENSOR_PACKER_HPP_
+#define _TENSOR_PACKER_HPP_
+
+#include "image_preprocess.hpp"
+
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Decoded BGR image straight into an accelerator's input layout in one pass: channel order,
+// NHWC or NCHW, uint8/float/fp16 elements and row padding. out can be any buffer of frame_size()
+// bytes, including memory the device reads directly, so no intermediate image or copy is needed.
+
+enum class TensorLayout {
+    NHWC,
+    NCHW
+};
+
+enum class TensorElement {
+    UINT8,
+    FLOAT32,
+    FLOAT16 // IEEE half bit patterns
+};
+
+struct TensorPackLayout {
+    int width = 0;
+    int height = 0;
+    TensorLayout layout = TensorLayout::NHWC;
+    TensorElement element = TensorElement::UINT8;
+    bool to_rgb = true;
+    size_t row_alignment = 1; // bytes (power of two); each row, or each plane row in NCHW, is padded to it
+    ChannelNormalization norm = ChannelNormalization::unit(); // float elements only
+
+    size_t element_size() const {
+        return (TensorElement::UINT8 == element) ? 1 : (TensorElement::FLOAT16 == element) ? 2 : 4;
+    }
+    size_t row_elements() const { return static_cast<size_t>(width) * ((TensorLayout::NHWC == layout) ? 3 : 1); }
+    size_t row_bytes() const {
+        const size_t alignment = std::max(row_alignment, element_size());
+        return (row_elements() * element_size() + alignment - 1) / alignment * alignment;
+    }
+    size_t frame_size() const { return row_bytes() * height * ((TensorLayout::NCHW == layout) ? 3 : 1); }
+
+    // DeepX .dxnn input: NHWC RGB bytes with every row padded to 64 bytes.
+    static TensorPackLayout dxnn(int width, int height) {
+        TensorPackLayout layout;
+        layout.width = width;
+        layout.height = height;
+        layout.row_alignment = 64;
+        return layout;
+    }
+};
+
+namespace packer_detail {
+
+inline void nhwc_u8_row(const uint8_t *src, int width, bool to_rgb, uint8_t *dst)
+{
+    if (!to_rgb) {
+        std::memcpy(dst, src, static_cast<size_t>(width) * 3);
+        return;
+    }
+    int x = 0;
+#if defined(SIMD_MATH_NEON)
+    for (; x + 16 <= width; x += 16) {
+        uint8x16x3_t pixels = vld3q_u8(src + 3 * x);
+        const uint8x16_t blue = pixels.val[0];
+        pixels.val[0] = pixels.val[2];
+        pixels.val[2] = blue;
+        vst3q_u8(dst + 3 * x, pixels);
+    }
+#endif
+    for (; x < width; ++x) {
+        dst[3 * x + 0] = src[3 * x + 2];
+        dst[3 * x + 1] = src[3 * x + 1];
+        dst[3 * x + 2] = src[3 * x + 0];
+    }
+}
+
+inline void nchw_u8_row(const uint8_t *src, int width, bool to_rgb, uint8_t *const planes[3])
+{
+    const int source[3] = {to_rgb ? 2 : 0, 1, to_rgb ? 0 : 2};
+    int x = 0;
+#if defined(SIMD_MATH_NEON)
+    for (; x + 16 <= width; x += 16) {
+        const uint8x16x3_t pixels = vld3q_u8(src + 3 * x);
+        for (int c = 0; c < 3; ++c) vst1q_u8(planes[c] + x, pixels.val[source[c]]);
+    }
+#endif
+    for (; x < width; ++x) {
+        for (int c = 0; c < 3; ++c) planes[c][x] = src[3 * x + source[c]];
+    }
+}
+
+template <typename Out>
+inline void nhwc_float_row(const uint8_t *src, int width, const preprocess_detail::Affine &affine, Out *dst)
+{
+    for (int x = 0; x < width; ++x, src += 3, dst += 3) {
+        for (int c = 0; c < 3; ++c) {
+            preprocess_detail::store_value(dst + c, src[affine.source[c]] * affine.scale[c] + affine.bias[c]);
+        }
+    }
+}
+
+} // namespace packer_detail
+
+// bgr: width x height pixels (the layout's size), row_stride bytes apart. Writes frame_size()
+// bytes to out, row padding zeroed.
+inline void pack_tensor(const uint8_t *bgr, int width, int height, size_t row_stride,
+                        const TensorPackLayout &layout, uint8_t *out)
+{
+    if (width != layout.width || height != layout.height) {
+        throw std::runtime_error("pack_tensor: image is " + std::to_string(width) + "x" + std::to_string(height) +
+                                 ", layout expects " + std::to_string(layout.width) + "x" + std::to_string(layout.height));
+    }
+    const size_t row_bytes = layout.row_bytes();
+    const size_t data_bytes = layout.row_elements() * layout.element_size();
+    const size_t planes = (TensorLayout::NCHW == layout.layout) ? 3 : 1;
+    if (row_bytes != data_bytes) {
+        for (size_t row = 0; row < planes * height; ++row) {
+            std::memset(out + row * row_bytes + data_bytes, 0, row_bytes - data_bytes);
+        }
+    }
+
+    const size_t plane_bytes = row_bytes * height;
+    if (TensorElement::UINT8 == layout.element) {
+        for (int y = 0; y < height; ++y) {
+            const uint8_t *src = bgr + y * row_stride;
+            uint8_t *dst = out + y * row_bytes;
+            if (TensorLayout::NHWC == layout.layout) {
+                packer_detail::nhwc_u8_row(src, width, layout.to_rgb, dst);
+            } else {
+                uint8_t *const dst_planes[3] = {dst, dst + plane_bytes, dst + 2 * plane_bytes};
+                packer_detail::nchw_u8_row(src, width, layout.to_rgb, dst_planes);
+            }
+        }
+        return;
+    }
+
+    auto pack_float = [&](auto *typed_out) {
+        using Out = std::remove_pointer_t<decltype(typed_out)>;
+        const size_t row_stride_elements = row_bytes / sizeof(Out);
+        if (TensorLayout::NCHW == layout.layout) {
+            preprocess_detail::bgr_to_chw(bgr, width, height, row_stride, layout.norm, typed_out, layout.to_rgb,
+                                          row_stride_elements, plane_bytes / sizeof(Out));
+            return;
+        }
+        const preprocess_detail::Affine affine(layout.norm, layout.to_rgb);
+        for (int y = 0; y < height; ++y) {
+            packer_detail::nhwc_float_row(bgr + y * row_stride, width, affine, typed_out + y * row_stride_elements);
+        }
+    };
+    if (TensorElement::FLOAT32 == layout.element) {
+        pack_float(reinterpret_cast<float *>(out));
+    } else {
+        pack_float(reinterpret_cast<uint16_t *>(out));
+    }
+}
+
+inline void pack_tensor(const cv::Mat &bgr, const TensorPackLayout &layout, uint8_t *out)
+{
+    if (bgr.type() != CV_8UC3) {
+        throw std::runtime_error("pack_tensor: expected an 8-bit, 3-channel BGR image");
+    }
+    pack_tensor(bgr.data, bgr.cols, bgr.rows, bgr.step, layout, out);
+}
+
+inline std::vector<uint8_t> pack_tensor(const cv::Mat &bgr, const TensorPackLayout &layout)
+{
+    std::vector<uint8_t> buffer(layout.frame_size());
+    pack_tensor(bgr, layout, buffer.data());
+    return buffer;
+}
+
+#endif /* _TENSOR_PACKER_HPP_ */
@@ -0,0 +1,260 @@
+#ifndef _YOLO_POSTPROCESS_HPP_
+#define _YOLO_POSTPROCESS_HPP_
+
+#include "fast_math.hpp"
+#include "label_type.h"
+#include "yolo_decode.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <vector>
+
+// Fused YOLOv5 postprocess: confidence filter, box decode and class-aware NMS in one pass over the
+// heads, producing Coco17DetectionResult records in input-pixel coordinates. Objectness is checked
+// first, and with logit heads the check runs on the raw logit against logit(threshold), so most
+// rows cost one load and one compare. Only the survivors get their class scores and box decoded.
+struct DetectionOptions {
+    // On objectness * class score. 0.001 is the threshold mAP is evaluated at (and the harness's);
+    // anything higher drops low-score true positives and lowers mAP.
+    float conf_threshold = 0.001f;
+    // true: one candidate per class above the threshold, as YOLOv5/v8 evaluate COCO mAP. false: the
+    // best class only, fewer candidates for NMS but a lower mAP.
+    bool multi_label = true;
+    float iou_threshold = 0.45f;
+    size_t max_detections = 300;
+    size_t max_candidates = 30000;  // as YOLOv5's max_nms: only the most confident go into NMS
+    bool class_agnostic = false;    // false: NMS only suppresses boxes of the same class
+    bool apply_sigmoid = true;      // see decode_yolov5_head_scalar
+    SigmoidApprox score_sigmoid = SigmoidApprox::EXACT;
+};
+
+inline float detection_iou(const Coco17DetectionResult &a, const Coco17DetectionResult &b)
+{
+    float x1 = std::max(a.top_left_x, b.top_left_x);
+    float y1 = std::max(a.top_left_y, b.top_left_y);
+    float x2 = std::min(a.top_left_x + a.width, b.top_left_x + b.width);
+    float y2 = std::min(a.top_left_y + a.height, b.top_left_y + b.height);
+    float inter = std::max(0.0f, x2 - x1) * std::max(0.0f, y2 - y1);
+    float uni = a.width * a.height + b.width * b.height - inter;
+    return (uni > 0.0f) ? inter / uni : 0.0f;
+}
+
+// Greedy NMS in place: detections end up sorted by confidence, at most max_detections kept. Only
+// the max_candidates most confident (ties at the cut included) are considered, and each is only
+// compared against the kept boxes it can be suppressed by, i.e. those of its class unless
+// class_agnostic.
+inline void non_max_suppression(std::vector<Coco17DetectionResult> &detections, float iou_threshold,
+                                size_t max_detections, bool class_agnostic, size_t max_candidates = 0)
+{
+    if (max_candidates > 0 && detections.size() > max_candidates) {
+        thread_local std::vector<float> confidences;
+        confidences.resize(detections.size());
+        for (size_t i = 0; i < detections.size(); ++i) confidences[i] = detections[i].confidence;
+        std::nth_element(confidences.begin(), confidences.begin() + (max_candidates - 1), confidences.end(), std::greater<float>());
+        const float cut = confidences[max_candidates - 1];
+        detections.erase(std::remove_if(detections.begin(), detections.end(),
+                                        [cut](const Coco17DetectionResult &d) { return d.confidence < cut; }),
+                         detections.end());
+    }
+    std::stable_sort(detections.begin(), detections.end(),
+                     [](const Coco17DetectionResult &a, const Coco17DetectionResult &b) { return a.confidence > b.confidence; });
+
+    thread_local std::vector<std::vector<size_t>> kept_by_class;
+    for (auto &bucket : kept_by_class) bucket.clear();
+    size_t kept = 0;
+    for (size_t i = 0; i < detections.size() && kept < max_detections; ++i) {
+        const size_t bucket = class_agnostic ? 0 : static_cast<size_t>(std::max(detections[i].classIndex, 0));
+        if (bucket >= kept_by_class.size()) kept_by_class.resize(bucket + 1);
+        bool suppressed = false;
+        for (size_t k : kept_by_class[bucket]) {
+            if (detection_iou(detections[k], detections[i]) > iou_threshold) {
+                suppressed = true;
+                break;
+            }
+        }
+        if (!suppressed) {
+            kept_by_class[bucket].push_back(kept);
+            detections[kept++] = detections[i];
+        }
+    }
+    detections.resize(kept);
+}
+
+inline void non_max_suppression(std::vector<Coco17DetectionResult> &detections, const DetectionOptions &options)
+{
+    non_max_suppression(detections, options.iou_threshold, options.max_detections, options.class_agnostic,
+                        options.max_candidates);
+}
+
+namespace yolo_detail {
+
+// Candidates of one decoded box from its activated class scores, see DetectionOptions::multi_label.
+inline void add_class_candidates(const float *scores, int classes, float objectness, float x, float y, float w, float h,
+                                 const DetectionOptions &options, std::vector<Coco17DetectionResult> &detections)
+{
+    if (options.multi_label) {
+        for (int c = 0; c < classes; ++c) {
+            const float confidence = objectness * scores[c];
+            if (confidence >= options.conf_threshold) {
+                detections.emplace_back(c, x, y, w, h, confidence);
+            }
+        }
+        return;
+    }
+    const int best = static_cast<int>(std::max_element(scores, scores + classes) - scores);
+    const float confidence = objectness * scores[best];
+    if (confidence >= options.conf_threshold) {
+        detections.emplace_back(best, x, y, w, h, confidence);
+    }
+}
+
+inline float logit(float p)
+{
+    return (p <= 0.0f) ? -INFINITY : (p >= 1.0f) ? INFINITY : std::log(p / (1.0f - p));
+}
+
+template <typename Reader>
+inline void collect_candidates(const YoloV5Head &head, const Reader &in, const DetectionOptions &options,
+                               std::vector<Coco17DetectionResult> &detections)
+{
+    const float threshold = options.conf_threshold;
+    // sigmoid is monotonic: obj >= threshold  <=>  logit >= log(t / (1 - t)).
+    const float objectness_cut = options.apply_sigmoid ? logit(threshold) : threshold;
+    auto activate = [&options](float v) { return options.apply_sigmoid ? fast_math::sigmoid(v, options.score_sigmoid) : v; };
+    auto activate_box = [&options](float v) { return options.apply_sigmoid ? fast_math::sigmoid(v) : v; };
+    const float stride_x = head.stride * head.box_scale[0], stride_y = head.stride * head.box_scale[1];
+    const int attributes = 5 + head.classes;
+
+    for (int y = 0; y < head.grid_h; ++y) {
+        for (int x = 0; x < head.grid_w; ++x) {
+            const size_t cell = (static_cast<size_t>(y) * head.grid_w + x) * head.cell_stride;
+            for (int a = 0; a < YOLOV5_ANCHORS_PER_CELL; ++a) {
+                const size_t raw = cell + a * attributes;
+                const float objectness = in.at(raw + 4);
+                if (objectness < objectness_cut) {
+                    continue;
+                }
+                const float obj = activate(objectness);
+                auto add = [&](int cls, float confidence) {
+                    float tx = activate_box(in.at(raw + 0)) * 2.0f;
+                    float ty = activate_box(in.at(raw + 1)) * 2.0f;
+                    float tw = activate_box(in.at(raw + 2)) * 2.0f;
+                    float th = activate_box(in.at(raw + 3)) * 2.0f;
+                    float cx = (tx - 0.5f + x) * stride_x + head.box_offset[0];
+                    float cy = (ty - 0.5f + y) * stride_y + head.box_offset[1];
+                    float w = tw * tw * head.anchors[a][0] * head.box_scale[0];
+                    float h = th * th * head.anchors[a][1] * head.box_scale[1];
+                    detections.emplace_back(cls, cx - 0.5f * w, cy - 0.5f * h, w, h, confidence);
+                };
+
+                if (options.multi_label) {
+                    // A class needs score >= threshold / obj. The raw compare only skips scores well
+                    // below that (the 0.5 logit margin covers the approximated sigmoids down to
+                    // scores of 1e-4); the product decides. The box is decoded for the first class.
+                    const float score_cut = options.apply_sigmoid ? logit(threshold / obj) - 0.5f : -INFINITY;
+                    const size_t first = detections.size();
+                    for (int c = 0; c < head.classes; ++c) {
+                        const float score = in.at(raw + 5 + c);
+                        if (score < score_cut) {
+                            continue;
+                        }
+                        const float confidence = obj * activate(score);
+                        if (confidence < threshold) {
+                            continue;
+                        }
+                        if (detections.size() == first) {
+                            add(c, confidence);
+                        } else {
+                            Coco17DetectionResult same_box = detections[first];
+                            same_box.classIndex = c;
+                            same_box.confidence = confidence;
+                            detections.push_back(same_box);
+                        }
+                    }
+                    continue;
+                }
+
+                // The best class is the same before and after the sigmoid.
+                int best = 0;
+                float best_score = in.at(raw + 5);
+                for (int c = 1; c < head.classes; ++c) {
+                    float score = in.at(raw + 5 + c);
+                    if (score > best_score) {
+                        best = c;
+                        best_score = score;
+                    }
+                }
+                float confidence = obj * activate(best_score);
+                if (confidence < threshold) {
+                    continue;
+                }
+                add(best, confidence);
+            }
+        }
+    }
+}
+
+} // namespace yolo_detail
+
+// Candidates that pass the confidence threshold in one head (appended to detections). Quantized
+// heads are dequantized element by element as the filter reads them.
+inline void collect_yolov5_candidates(const YoloV5Head &head, const DetectionOptions &options,
+                                      std::vector<Coco17DetectionResult> &detections)
+{
+    yolo_detail::with_head_reader(head, [&](const auto &in) { yolo_detail::collect_candidates(head, in, options, detections); });
+}
+
+// detections is cleared and refilled, so passing the same vector per frame avoids reallocating.
+inline void detect_yolov5(const std::vector<YoloV5Head> &heads, const DetectionOptions &options,
+                          std::vector<Coco17DetectionResult> &detections)
+{
+    detections.clear();
+    for (const auto &head : heads) {
+        collect_yolov5_candidates(head, options, detections);
+    }
+    non_max_suppression(detections, options);
+}
+
+// Same filter and NMS on rows that are already decoded to [cx, cy, w, h, obj, class scores]; with
+// 80 classes this is what the harness does with the full 25200 x 85 tensor. Used to cross-check
+// detect_yolov5 and the decoders in detection_decoders.hpp.
+inline void detect_from_yolov5_rows(const float *rows, size_t row_count, const DetectionOptions &options,
+                                    std::vector<Coco17DetectionResult> &detections,
+                                    int class_count = YOLOV5_ATTRIBUTES - 5)
+{
+    detections.clear();
+    for (size_t r = 0; r < row_count; ++r) {
+        const float *row = rows + r * (5 + static_cast<size_t>(class_count));
+        if (row[4] < options.conf_threshold) {
+            continue;
+        }
+        yolo_detail::add_class_candidates(row + 5, class_count, row[4], row[0] - 0.5f * row[2], row[1] - 0.5f * row[3],
+                                          row[2], row[3], options, detections);
+    }
+    non_max_suppression(detections, options);
+}
+
+// The harness still takes the 25200 x 85 tensor. This writes each detection as one row with
+// objectness 1 and its confidence as the only class score, and zeros elsewhere. The harness's own
+// threshold and NMS then keep exactly these boxes. Detections of classes the rows have no score
+// for (outside COCO's 80) are dropped.
+inline void write_detections_as_yolov5_rows(const std::vector<Coco17DetectionResult> &detections, size_t row_count,
+                                            std::vector<float> &output)
+{
+    output.assign(row_count * YOLOV5_ATTRIBUTES, 0.0f);
+    size_t written = 0;
+    for (size_t i = 0; i < detections.size() && written < row_count; ++i) {
+        const Coco17DetectionResult &d = detections[i];
+        if (d.classIndex < 0 || d.classIndex >= YOLOV5_ATTRIBUTES - 5) continue;
+        float *row = output.data() + written++ * YOLOV5_ATTRIBUTES;
+        row[0] = d.top_left_x + 0.5f * d.width;
+        row[1] = d.top_left_y + 0.5f * d.height;
+        row[2] = d.width;
+        row[3] = d.height;
+        row[4] = 1.0f;
+        row[5 + d.classIndex] = d.confidence;
+    }
+}
+
+#endif /* _YOLO_POSTPROCESS_HPP_ */